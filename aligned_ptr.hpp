@@ -51,9 +51,12 @@ public:
 	{
 		free();
 
-		if (0 != capacity) {
+		// on failure, or on a capacity past the address space, leave the pointer null
+		if (0 != capacity && capacity <= (size_t(-1) - (ALIGNMENT_T - 1)) / sizeof(T)) {
 			void* const unaligned = ::malloc(sizeof(T) * capacity + ALIGNMENT_T - 1);
-			ptr = reinterpret_cast< void* >(uintptr_t(unaligned) + uintptr_t(ALIGNMENT_T - 1));
+
+			if (0 != unaligned)
+				ptr = reinterpret_cast< void* >(uintptr_t(unaligned) + uintptr_t(ALIGNMENT_T - 1));
 		}
 	}
 
@@ -2,8 +2,11 @@
 /// This software is provided under the MIT License; see LICENSE file for details.
 
 #if !defined(__bsearch_H__)
+#define __bsearch_H__
 
 #include <cassert>
+#include <string.h>
+#include "aligned_ptr.hpp"
 
 #ifndef ROUTINE_ALIGNMENT
 #define bsearch_ROUTINE_ALIGNMENT CACHELINE_SIZE
@@ -32,8 +35,8 @@ inline size_t breadth_from_linear(
 	assert(2 <= space_size && 0 == (space_size & space_size - 1));
 	assert(0 <= pos && pos < space_size - 1);
 
-	// bottom-up log2 level corresponds to the index of the first unset bit in the position
-	const size_t level = bitscan(int64_t(~pos));
+	// bottom-up log2 level corresponds to the index of the first unset bit in the position; bitscan is one-based
+	const size_t level = bitscan(int64_t(~pos)) - 1;
 
 	return (size_t(1) << (log2_from_pot(space_size) - level - 1)) + (pos >> (level + 1)) - 1;
 }
@@ -438,6 +441,100 @@ inline size_t bsearch_veb_iter(
 	return bsearch_van_emde_boas_iter(space, key, LOG2_SUBSIZE, log2_from_pot(space_size) / LOG2_SUBSIZE);
 }
 
+// Exact-match searches returning the sorted rank of the item found, i.e. its position in the sorted space, instead
+// of its layout position, or size_t(-1) if the key is absent; the rank of the standard layout is its position, so
+// bsearch_standard needs no such version. The tree versions derive the rank from the path to the item at the cost
+// of a shift, so callers keeping payloads in sorted order need not map layout positions back.
+
+template < size_t LEADIN_SIZE, typename SEARCHITEM_T, typename KEY_T >
+inline size_t bsearch_binned_rank(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key)
+{
+	const size_t pos = bsearch_binned< LEADIN_SIZE >(space, space_size, key);
+
+	return size_t(-1) == pos ? pos : pos - LEADIN_SIZE;
+}
+
+template < typename SEARCHITEM_T, typename KEY_T >
+inline size_t bsearch_breadth_rank(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key)
+{
+	assert(2 <= space_size && 0 == (space_size & space_size - 1));
+
+	const size_t num_level = log2_from_pot(space_size);
+	size_t level_pos = 0;
+
+	for (size_t level = 0; level < num_level; ++level) {
+		const size_t level_start = (size_t(1) << level) - 1;
+		const size_t seek_pos = level_start + level_pos;
+		const KEY_T k = space[seek_pos];
+
+		// as per linear_from_breadth
+		if (key == k)
+			return (space_size >> level + 1) * (level_pos * 2 + 1) - 1;
+
+		const size_t inc = key > k ? 1 : 0;
+
+		level_pos = level_pos * 2 + inc;
+	}
+
+	return size_t(-1);
+}
+
+template < typename SEARCHITEM_T, typename KEY_T >
+inline size_t bsearch_van_emde_boas_iter_rank(
+	const SEARCHITEM_T* const space,
+	const KEY_T key,
+	const size_t num_level,
+	const size_t num_macro)
+{
+	size_t macro_pos = 0;
+	size_t macro_base = 0;
+
+	for (size_t macro = 0; macro < num_macro; ++macro) {
+		const size_t tree_start = macro_pos + macro_base << num_level;
+		size_t level_pos = 0;
+
+		for (size_t level = 0; level < num_level; ++level) {
+			const size_t level_start = tree_start + (size_t(1) << level) - 1;
+			const size_t seek_pos = level_start + level_pos;
+			const KEY_T k = space[seek_pos];
+
+			// the path to the item, followed by a one and as many zeros as there are levels below the item,
+			// spells out the one-based sorted position of the item
+			if (key == k) {
+				const size_t num_below = (num_macro - macro) * num_level - level - 1;
+				return ((macro_pos << level | level_pos) * 2 + 1 << num_below) - 1;
+			}
+
+			const size_t inc = key > k ? 1 : 0;
+
+			level_pos = level_pos * 2 + inc;
+		}
+
+		macro_pos = (macro_pos << num_level) + level_pos;
+		macro_base += 1 << macro * num_level;
+	}
+
+	return size_t(-1);
+}
+
+template < size_t LOG2_SUBSIZE, typename SEARCHITEM_T, typename KEY_T >
+inline size_t bsearch_veb_iter_rank(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key)
+{
+	assert(2 <= space_size && 0 == (space_size & space_size - 1));
+	assert(0 == log2_from_pot(space_size) % LOG2_SUBSIZE);
+
+	return bsearch_van_emde_boas_iter_rank(space, key, LOG2_SUBSIZE, log2_from_pot(space_size) / LOG2_SUBSIZE);
+}
+
 template < typename SEARCHITEM_T, typename KEY_T >
 inline void prepare_for_binned_search(
 	KEY_T* const leadin,
@@ -471,6 +568,99 @@ inline size_t prepare_for_breadth_search(
 	return 1;
 }
 
+// depth of the top tree in a Van Emde Boas forest whose depth is not a multiple of the subtree depth; all other
+// trees in the forest are of the full subtree depth
+inline size_t veb_top_level(
+	const size_t log2_size,
+	const size_t log2_subsize)
+{
+	return log2_size % log2_subsize ? log2_size % log2_subsize : log2_subsize;
+}
+
+// number of items a Van Emde Boas forest occupies, including the padding of each tree to the subtree size
+inline size_t veb_total_size(
+	const size_t space_size, // power of two
+	const size_t subsize)    // power of two
+{
+	const size_t log2_size = log2_from_pot(space_size);
+	const size_t log2_subsize = log2_from_pot(subsize);
+	const size_t log2_top = veb_top_level(log2_size, log2_subsize);
+
+	size_t num_tree = 0;
+
+	for (size_t depth = 0; depth < log2_size; depth += depth ? log2_subsize : log2_top)
+		num_tree += size_t(1) << depth;
+
+	return num_tree * subsize;
+}
+
+// position in a Van Emde Boas forest of the item at the specified position of the sorted space
+inline size_t veb_from_linear(
+	const size_t space_size, // power of two
+	const size_t log2_subsize,
+	const size_t pos)
+{
+	assert(2 <= space_size && 0 == (space_size & space_size - 1));
+	assert(0 <= pos && pos < space_size - 1);
+
+	const size_t log2_size = log2_from_pot(space_size);
+	const size_t log2_top = veb_top_level(log2_size, log2_subsize);
+
+	// bottom-up level of the item corresponds to the index of the first unset bit in the position
+	const size_t level = log2_size - bitscan(int64_t(~pos));
+
+	// depth of the tree holding the item, and number of trees at lesser depths
+	size_t depth = 0;
+	size_t num_tree = 0;
+
+	if (level >= log2_top) {
+		const size_t band = (level - log2_top) / log2_subsize;
+
+		depth = log2_top + band * log2_subsize;
+		num_tree = 1 + (size_t(1) << log2_top) * ((size_t(1) << band * log2_subsize) - 1) / ((size_t(1) << log2_subsize) - 1);
+	}
+
+	const size_t i = level - depth;
+	const size_t t = pos >> log2_size - depth;
+	const size_t j = (pos & (size_t(1) << log2_size - depth) - 1) >> log2_size - depth - i;
+
+	return (num_tree + t << log2_subsize) + (size_t(1) << i) - 1 + j;
+}
+
+// position in the sorted space of the item at the specified position of a Van Emde Boas forest, padding excluded;
+// the inverse of veb_from_linear
+inline size_t linear_from_veb(
+	const size_t space_size, // power of two
+	const size_t log2_subsize,
+	const size_t pos)
+{
+	assert(2 <= space_size && 0 == (space_size & space_size - 1));
+
+	const size_t log2_size = log2_from_pot(space_size);
+	const size_t tree = pos >> log2_subsize;
+	const size_t slot = pos & (size_t(1) << log2_subsize) - 1;
+
+	// depth of the tree and index of the first tree at that depth: the top tree, then 2 ^ depth trees per depth
+	size_t depth = 0;
+	size_t first = 0;
+	size_t log2_tree = veb_top_level(log2_size, log2_subsize);
+
+	while (tree >= first + (size_t(1) << depth)) {
+		first += size_t(1) << depth;
+		depth += log2_tree;
+		log2_tree = log2_subsize;
+	}
+
+	// level and position of the slot within the tree, laid out breadth-first
+	const size_t i = sizeof(unsigned long) * 8 - 1 - __builtin_clzl((unsigned long)(slot + 1));
+	const size_t j = slot + 1 - (size_t(1) << i);
+	const size_t stride = size_t(1) << log2_size - depth;
+
+	assert(i < log2_tree);
+
+	return (tree - first) * stride + (stride >> i + 1) * (j * 2 + 1) - 1;
+}
+
 template < typename SEARCHITEM_T >
 inline size_t prepare_for_veb_search(
 	SEARCHITEM_T* const space_dst,
@@ -488,29 +678,1781 @@ inline size_t prepare_for_veb_search(
 	const size_t log2_size = log2_from_pot(len_src);
 	const size_t log2_subsize = log2_from_pot(subsize);
 
-	if (log2_size % log2_subsize)
-		return 0;
+	// a depth that is not a multiple of the subtree depth is accommodated by a shallower top tree; such forests
+	// are searchable by the lower-bound routines only
+	const size_t log2_top = veb_top_level(log2_size, log2_subsize);
 
 	// increase the subtree size to 2 ^ log2_subtree; account for the extra space by counting the subtrees in the big tree
-	const size_t total_size = (len_src - 1) / (subsize - 1) * subsize;
+	const size_t total_size = veb_total_size(len_src, subsize);
 
 	if (total_size > len_dst)
 		return 0;
 
-	for (size_t f = 0, walk = 0; f < log2_size / log2_subsize; ++f)    // tree depth iteration
-		for (size_t t = 0; t < (1 << f * log2_subsize); ++t, ++walk) { // tree breadth iteration
-			for (size_t i = 0; i < log2_subsize; ++i)                  // subtree depth iteration
-				for (size_t j = 0; j < 1 << i; ++j, ++walk) {          // subtree breadth iteration
-					space_dst[walk] = space_src[t * (1 << log2_size - f * log2_subsize) +
-						(1 << log2_size - f * log2_subsize - (i + 1)) * (j * 2 + 1) - 1];
+	for (size_t depth = 0, walk = 0; depth < log2_size; ) {                   // tree depth iteration
+		const size_t log2_tree = depth ? log2_subsize : log2_top;
+		const size_t stride = size_t(1) << log2_size - depth;
+
+		for (size_t t = 0; t < size_t(1) << depth; ++t) {                      // tree breadth iteration
+			for (size_t i = 0; i < log2_tree; ++i)                             // subtree depth iteration
+				for (size_t j = 0; j < size_t(1) << i; ++j, ++walk) {          // subtree breadth iteration
+					space_dst[walk] = space_src[t * stride + (stride >> i + 1) * (j * 2 + 1) - 1];
 				}
 
-			space_dst[walk] = 0.f; // padding to subtree size of 2 ^ log2_subtree
+			for (size_t i = (size_t(1) << log2_tree) - 1; i < subsize; ++i, ++walk)
+				space_dst[walk] = 0.f; // padding to subtree size of 2 ^ log2_subtree
 		}
 
+		depth += log2_tree;
+	}
+
 	return 1;
 }
 
+// Lower- and upper-bound searches: unlike the exact-match searches above, these always descend to the bottom of
+// the tree, so that the path taken spells out the sorted rank of the bound, i.e. the number of items less than the
+// key for lower bounds, the number of items not greater than the key for upper bounds; under duplicates, the two
+// delimit the run of items equal to the key, as std::equal_range does. The tree versions also return the layout
+// position of the bound item in pos, or size_t(-1) if all items go before the bound. Each bbound routine serves
+// both bounds; blowerbound and bupperbound are the two instances.
+
+// whether an item goes before the bound of a key: items less than the key for lower bounds, items not greater than
+// the key for upper bounds
+template < bool UPPER, typename KEY_T >
+inline bool before_bound(
+	const KEY_T item,
+	const KEY_T key)
+{
+	return UPPER ? !(key < item) : item < key;
+}
+
+template < bool UPPER, typename SEARCHITEM_T, typename KEY_T >
+inline size_t bbound_standard(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key)
+{
+	assert(0 != space_size);
+
+	const SEARCHITEM_T* base = space;
+	size_t len = space_size;
+
+	while (len > 1) {
+		const size_t half = len / 2;
+		const KEY_T k = base[half];
+
+		base = before_bound< UPPER >(k, key) ? base + half : base;
+		len -= half;
+	}
+
+	const KEY_T k = *base;
+	return size_t(base - space) + (before_bound< UPPER >(k, key) ? 1 : 0);
+}
+
+template < typename SEARCHITEM_T, typename KEY_T >
+inline size_t blowerbound_standard(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key)
+{
+	return bbound_standard< false >(space, space_size, key);
+}
+
+template < typename SEARCHITEM_T, typename KEY_T >
+inline size_t bupperbound_standard(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key)
+{
+	return bbound_standard< true >(space, space_size, key);
+}
+
+template < bool UPPER, size_t LEADIN_SIZE, typename SEARCHITEM_T, typename KEY_T >
+inline size_t bbound_binned(
+	const KEY_T* const leadin,
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key)
+{
+	if (before_bound< UPPER >(leadin[0], key))
+		return space_size;
+
+	size_t i = 1;
+
+	// unlike the exact-match search, stop only at the bin whose first item goes before the bound -- for lower
+	// bounds, a bin starting with the key itself may be preceded by more occurrences of the key
+	while (i < LEADIN_SIZE && !before_bound< UPPER >(leadin[i], key))
+		++i;
+
+	const size_t left = (LEADIN_SIZE - i) * space_size / LEADIN_SIZE;
+	const size_t right = (LEADIN_SIZE - i + 1) * space_size / LEADIN_SIZE;
+
+	if (left == right)
+		return left;
+
+	return bbound_standard< UPPER >(space + left, right - left, key) + left;
+}
+
+template < size_t LEADIN_SIZE, typename SEARCHITEM_T, typename KEY_T >
+inline size_t blowerbound_binned(
+	const KEY_T* const leadin,
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key)
+{
+	return bbound_binned< false, LEADIN_SIZE >(leadin, space, space_size, key);
+}
+
+template < size_t LEADIN_SIZE, typename SEARCHITEM_T, typename KEY_T >
+inline size_t bupperbound_binned(
+	const KEY_T* const leadin,
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key)
+{
+	return bbound_binned< true, LEADIN_SIZE >(leadin, space, space_size, key);
+}
+
+template < bool UPPER, typename SEARCHITEM_T, typename KEY_T >
+inline size_t bbound_breadth(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key,
+	size_t& pos)
+{
+	assert(2 <= space_size && 0 == (space_size & space_size - 1));
+
+	size_t seek_pos = 0;
+
+	// children of the item at position i are found at positions 2i + 1 and 2i + 2
+	while (seek_pos < space_size - 1) {
+		const KEY_T k = space[seek_pos];
+		const size_t inc = before_bound< UPPER >(k, key) ? 1 : 0;
+
+		seek_pos = seek_pos * 2 + 1 + inc;
+	}
+
+	// the bound item is the last one the search turned left at; in one-based positions that is the final
+	// position with its trailing right turns (set bits), plus the final left turn, shifted out
+	const size_t leaf = seek_pos + 1;
+
+	pos = (leaf >> bitscan(int64_t(~leaf))) - 1;
+
+	return seek_pos - (space_size - 1);
+}
+
+template < typename SEARCHITEM_T, typename KEY_T >
+inline size_t blowerbound_breadth(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key,
+	size_t& pos)
+{
+	return bbound_breadth< false >(space, space_size, key, pos);
+}
+
+template < typename SEARCHITEM_T, typename KEY_T >
+inline size_t bupperbound_breadth(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key,
+	size_t& pos)
+{
+	return bbound_breadth< true >(space, space_size, key, pos);
+}
+
+template < bool UPPER, typename SEARCHITEM_T, typename KEY_T >
+inline size_t bbound_van_emde_boas(
+	const SEARCHITEM_T* const space,
+	const KEY_T key,
+	const size_t num_level,
+	const size_t num_top_level,
+	const size_t num_macro,
+	size_t& pos)
+{
+	size_t macro_pos = 0;
+	size_t macro_base = 0;
+	size_t macro_depth = 0;
+	size_t num_tree_level = num_top_level;
+
+	pos = size_t(-1);
+
+	for (size_t macro = 0; macro < num_macro; ++macro) {
+		const size_t tree_start = macro_pos + macro_base << num_level;
+		size_t level_pos = 0;
+
+		for (size_t level = 0; level < num_tree_level; ++level) {
+			const size_t level_start = tree_start + (size_t(1) << level) - 1;
+			const size_t seek_pos = level_start + level_pos;
+			const KEY_T k = space[seek_pos];
+			const size_t inc = before_bound< UPPER >(k, key) ? 1 : 0;
+
+			pos = inc ? pos : seek_pos;
+			level_pos = level_pos * 2 + inc;
+		}
+
+		macro_pos = (macro_pos << num_tree_level) + level_pos;
+		macro_base += size_t(1) << macro_depth;
+		macro_depth += num_tree_level;
+		num_tree_level = num_level;
+	}
+
+	return macro_pos;
+}
+
+template < typename SEARCHITEM_T, typename KEY_T >
+inline size_t blowerbound_van_emde_boas(
+	const SEARCHITEM_T* const space,
+	const KEY_T key,
+	const size_t num_level,
+	const size_t num_top_level,
+	const size_t num_macro,
+	size_t& pos)
+{
+	return bbound_van_emde_boas< false >(space, key, num_level, num_top_level, num_macro, pos);
+}
+
+template < bool UPPER, size_t LOG2_SUBSIZE, typename SEARCHITEM_T, typename KEY_T >
+inline size_t bbound_veb(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key,
+	size_t& pos)
+{
+	assert(2 <= space_size && 0 == (space_size & space_size - 1));
+
+	const size_t log2_size = log2_from_pot(space_size);
+	const size_t log2_top = veb_top_level(log2_size, LOG2_SUBSIZE);
+
+	return bbound_van_emde_boas< UPPER >(space, key, LOG2_SUBSIZE, log2_top, (log2_size - log2_top) / LOG2_SUBSIZE + 1, pos);
+}
+
+template < size_t LOG2_SUBSIZE, typename SEARCHITEM_T, typename KEY_T >
+inline size_t blowerbound_veb(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key,
+	size_t& pos)
+{
+	return bbound_veb< false, LOG2_SUBSIZE >(space, space_size, key, pos);
+}
+
+template < size_t LOG2_SUBSIZE, typename SEARCHITEM_T, typename KEY_T >
+inline size_t bupperbound_veb(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key,
+	size_t& pos)
+{
+	return bbound_veb< true, LOG2_SUBSIZE >(space, space_size, key, pos);
+}
+
+// Bound searches over a tree whose top slots are mirrored by 16-bit order-preserving prefixes of their items,
+// see key_quantizer below: a key is compared against the prefix of an item first, and against the item itself only
+// if the two prefixes tie, so that the top levels take a half or a quarter of the cache lines they would otherwise.
+
+template < bool UPPER, typename SEARCHITEM_T, typename KEY_T >
+inline size_t bbound_breadth_prefix(
+	const uint16_t* const prefix,
+	const size_t num_prefix, // number of prefixed slots, a whole number of levels
+	const uint16_t key_prefix,
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T key,
+	size_t& pos)
+{
+	assert(2 <= space_size && 0 == (space_size & space_size - 1));
+
+	size_t seek_pos = 0;
+
+	while (seek_pos < num_prefix) {
+		// the sign of the difference of the prefixes is the turn, lest it be compiled to a branch; ties are rare
+		// past the top few levels, so the load of the full item is left to a branch
+		const int64_t diff = int64_t(prefix[seek_pos]) - int64_t(key_prefix);
+		size_t inc = size_t(uint64_t(diff) >> 63);
+
+		if (__builtin_expect(0 == diff, 0))
+			inc = before_bound< UPPER >(KEY_T(space[seek_pos]), key) ? 1 : 0;
+
+		seek_pos = seek_pos * 2 + 1 + inc;
+	}
+
+	while (seek_pos < space_size - 1) {
+		const KEY_T k = space[seek_pos];
+		const size_t inc = before_bound< UPPER >(k, key) ? 1 : 0;
+
+		seek_pos = seek_pos * 2 + 1 + inc;
+	}
+
+	const size_t leaf = seek_pos + 1;
+
+	pos = (leaf >> bitscan(int64_t(~leaf))) - 1;
+
+	return seek_pos - (space_size - 1);
+}
+
+template < bool UPPER, typename SEARCHITEM_T, typename KEY_T >
+inline size_t bbound_van_emde_boas_prefix(
+	const uint16_t* const prefix,
+	const size_t num_prefix_macro, // number of macro levels whose slots are prefixed
+	const uint16_t key_prefix,
+	const SEARCHITEM_T* const space,
+	const KEY_T key,
+	const size_t num_level,
+	const size_t num_top_level,
+	const size_t num_macro,
+	size_t& pos)
+{
+	size_t macro_pos = 0;
+	size_t macro_base = 0;
+	size_t macro_depth = 0;
+	size_t num_tree_level = num_top_level;
+
+	pos = size_t(-1);
+
+	for (size_t macro = 0; macro < num_macro; ++macro) {
+		const size_t tree_start = macro_pos + macro_base << num_level;
+		const bool prefixed = macro < num_prefix_macro;
+		size_t level_pos = 0;
+
+		for (size_t level = 0; level < num_tree_level; ++level) {
+			const size_t level_start = tree_start + (size_t(1) << level) - 1;
+			const size_t seek_pos = level_start + level_pos;
+			size_t inc;
+
+			if (prefixed) {
+				const int64_t diff = int64_t(prefix[seek_pos]) - int64_t(key_prefix);
+				inc = size_t(uint64_t(diff) >> 63);
+
+				if (__builtin_expect(0 == diff, 0))
+					inc = before_bound< UPPER >(KEY_T(space[seek_pos]), key) ? 1 : 0;
+			}
+			else
+				inc = before_bound< UPPER >(KEY_T(space[seek_pos]), key) ? 1 : 0;
+
+			pos = inc ? pos : seek_pos;
+			level_pos = level_pos * 2 + inc;
+		}
+
+		macro_pos = (macro_pos << num_tree_level) + level_pos;
+		macro_base += size_t(1) << macro_depth;
+		macro_depth += num_tree_level;
+		num_tree_level = num_level;
+	}
+
+	return macro_pos;
+}
+
+// Batch lower-bound searches: a group of keys descends the tree in lockstep, one level at a time, so that the
+// cache misses of the group overlap; the next item of each key is prefetched as soon as it is known.
+
+template < size_t GROUP_SIZE, typename SEARCHITEM_T, typename KEY_T >
+inline void blowerbound_standard_batch(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T* const key,
+	size_t* const rank)
+{
+	assert(0 != space_size);
+
+	const SEARCHITEM_T* base[GROUP_SIZE];
+	size_t len = space_size;
+
+	for (size_t g = 0; g < GROUP_SIZE; ++g)
+		base[g] = space;
+
+	while (len > 1) {
+		const size_t half = len / 2;
+
+		len -= half;
+
+		for (size_t g = 0; g < GROUP_SIZE; ++g) {
+			const KEY_T k = base[g][half];
+
+			base[g] = k < key[g] ? base[g] + half : base[g];
+			__builtin_prefetch(base[g] + len / 2);
+		}
+	}
+
+	for (size_t g = 0; g < GROUP_SIZE; ++g) {
+		const KEY_T k = *base[g];
+		rank[g] = size_t(base[g] - space) + (k < key[g] ? 1 : 0);
+	}
+}
+
+template < size_t GROUP_SIZE, typename SEARCHITEM_T, typename KEY_T >
+inline void blowerbound_breadth_batch(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T* const key,
+	size_t* const rank,
+	size_t* const pos)
+{
+	assert(2 <= space_size && 0 == (space_size & space_size - 1));
+
+	const size_t num_level = log2_from_pot(space_size);
+	size_t seek_pos[GROUP_SIZE];
+
+	for (size_t g = 0; g < GROUP_SIZE; ++g)
+		seek_pos[g] = 0;
+
+	for (size_t level = 0; level < num_level; ++level)
+		for (size_t g = 0; g < GROUP_SIZE; ++g) {
+			const KEY_T k = space[seek_pos[g]];
+			const size_t inc = k < key[g] ? 1 : 0;
+
+			seek_pos[g] = seek_pos[g] * 2 + 1 + inc;
+			__builtin_prefetch(space + seek_pos[g] * 2 + 1);
+		}
+
+	for (size_t g = 0; g < GROUP_SIZE; ++g) {
+		const size_t leaf = seek_pos[g] + 1;
+
+		pos[g] = (leaf >> bitscan(int64_t(~leaf))) - 1;
+		rank[g] = seek_pos[g] - (space_size - 1);
+	}
+}
+
+template < size_t LOG2_SUBSIZE, size_t GROUP_SIZE, typename SEARCHITEM_T, typename KEY_T >
+inline void blowerbound_veb_batch(
+	const SEARCHITEM_T* const space,
+	const size_t space_size,
+	const KEY_T* const key,
+	size_t* const rank,
+	size_t* const pos)
+{
+	assert(2 <= space_size && 0 == (space_size & space_size - 1));
+
+	const size_t log2_size = log2_from_pot(space_size);
+	size_t num_tree_level = veb_top_level(log2_size, LOG2_SUBSIZE);
+	size_t macro_base = 0;
+	size_t macro_depth = 0;
+	size_t tree_start[GROUP_SIZE];
+	size_t level_pos[GROUP_SIZE];
+
+	for (size_t g = 0; g < GROUP_SIZE; ++g) {
+		rank[g] = 0;
+		pos[g] = size_t(-1);
+	}
+
+	while (macro_depth < log2_size) {
+		for (size_t g = 0; g < GROUP_SIZE; ++g) {
+			tree_start[g] = rank[g] + macro_base << LOG2_SUBSIZE;
+			level_pos[g] = 0;
+			__builtin_prefetch(space + tree_start[g]);
+		}
+
+		for (size_t level = 0; level < num_tree_level; ++level)
+			for (size_t g = 0; g < GROUP_SIZE; ++g) {
+				const size_t seek_pos = tree_start[g] + (size_t(1) << level) - 1 + level_pos[g];
+				const KEY_T k = space[seek_pos];
+				const size_t inc = k < key[g] ? 1 : 0;
+
+				pos[g] = inc ? pos[g] : seek_pos;
+				level_pos[g] = level_pos[g] * 2 + inc;
+			}
+
+		for (size_t g = 0; g < GROUP_SIZE; ++g)
+			rank[g] = (rank[g] << num_tree_level) + level_pos[g];
+
+		macro_base += size_t(1) << macro_depth;
+		macro_depth += num_tree_level;
+		num_tree_level = LOG2_SUBSIZE;
+	}
+}
+
+// Multi-table exact-match search: one key searched in a number of VEB forests of any sizes at once, e.g. the
+// partitions of a table, their descents interleaved one level at a time, so that the cache misses of the tables
+// overlap rather than follow one another; the next tree of each forest is prefetched as soon as it is known. The
+// descents are lower-bound ones, to the bottom of each forest, whose depth need not be a multiple of the subtree
+// depth; the bound is then compared to the key. Returns the layout position of the key in each forest, or
+// size_t(-1) where absent, as bsearch_veb_iter does.
+
+template < size_t LOG2_SUBSIZE, typename SEARCHITEM_T, typename KEY_T >
+inline void bsearch_veb_multi(
+	const SEARCHITEM_T* const* const space,
+	const size_t* const space_size,
+	const size_t num_table,
+	const KEY_T key,
+	size_t* const pos)
+{
+	static const size_t max_table = 16; // number of forests per interleaved descent
+
+	for (size_t first = 0; first < num_table; first += max_table) {
+		const size_t count = num_table - first < max_table ? num_table - first : max_table;
+		const SEARCHITEM_T* base[max_table];
+		size_t log2_size[max_table];
+		size_t num_tree_level[max_table];
+		size_t macro_base[max_table];
+		size_t macro_depth[max_table];
+		size_t tree_start[max_table];
+		size_t level_pos[max_table];
+		size_t rank[max_table];
+		size_t bound[max_table];
+		size_t active[max_table]; // forests not yet at their bottom
+		size_t num_active = count;
+
+		for (size_t t = 0; t < count; ++t) {
+			assert(2 <= space_size[first + t] && 0 == (space_size[first + t] & space_size[first + t] - 1));
+
+			base[t] = space[first + t];
+			log2_size[t] = log2_from_pot(space_size[first + t]);
+			num_tree_level[t] = veb_top_level(log2_size[t], LOG2_SUBSIZE);
+			macro_base[t] = 0;
+			macro_depth[t] = 0;
+			tree_start[t] = 0;
+			rank[t] = 0;
+			bound[t] = size_t(-1);
+			active[t] = t;
+		}
+
+		// a tree of every forest not yet at its bottom per step; the top trees may be shallower than the rest
+		while (num_active) {
+			for (size_t a = 0; a < num_active; ++a)
+				level_pos[active[a]] = 0;
+
+			for (size_t level = 0; level < LOG2_SUBSIZE; ++level)
+				for (size_t a = 0; a < num_active; ++a) {
+					const size_t t = active[a];
+
+					if (level >= num_tree_level[t])
+						continue;
+
+					const size_t seek_pos = tree_start[t] + (size_t(1) << level) - 1 + level_pos[t];
+					const KEY_T k = base[t][seek_pos];
+					const size_t inc = k < key ? 1 : 0;
+
+					bound[t] = inc ? bound[t] : seek_pos;
+					level_pos[t] = level_pos[t] * 2 + inc;
+				}
+
+			size_t next_active = 0;
+
+			for (size_t a = 0; a < num_active; ++a) {
+				const size_t t = active[a];
+
+				rank[t] = (rank[t] << num_tree_level[t]) + level_pos[t];
+				macro_base[t] += size_t(1) << macro_depth[t];
+				macro_depth[t] += num_tree_level[t];
+				num_tree_level[t] = LOG2_SUBSIZE;
+				tree_start[t] = rank[t] + macro_base[t] << LOG2_SUBSIZE;
+
+				if (macro_depth[t] < log2_size[t]) {
+					__builtin_prefetch(base[t] + tree_start[t]);
+					active[next_active++] = t;
+				}
+			}
+
+			num_active = next_active;
+		}
+
+		for (size_t t = 0; t < count; ++t)
+			pos[first + t] = size_t(-1) != bound[t] && base[t][bound[t]] == key ? bound[t] : size_t(-1);
+	}
+}
+
+// layout tags for search::index
+struct layout_standard {};
+template < size_t LEADIN_SIZE > struct layout_binned {};
+struct layout_breadth {};
+template < size_t LOG2_SUBSIZE > struct layout_veb {};
+template < typename BASE_LAYOUT_T, size_t PREFIX_LEVELS > struct layout_prefix {}; // breadth or VEB base only
+
+// smallest power-of-two space size of a complete tree that holds the specified number of items
+inline size_t tree_space_size(
+	const size_t len)
+{
+	size_t space_size = 2;
+
+	while (space_size - 1 < len)
+		space_size <<= 1;
+
+	return space_size;
+}
+
+// pad a sorted array to the item count of a complete tree by repeating its last item; the padding compares equal
+// to the last item, so lower-bound searches never resolve to it, save for keys past the last item; return null if
+// the padded copy cannot be allocated
+template < typename KEY_T, size_t ALIGNMENT_T >
+inline const KEY_T* pad_for_tree(
+	aligned_ptr< KEY_T, ALIGNMENT_T >& padded,
+	const KEY_T* const src,
+	const size_t len_src,
+	const size_t space_size)
+{
+	if (len_src == space_size - 1)
+		return src;
+
+	padded.malloc(space_size - 1);
+
+	if (padded.is_null())
+		return 0;
+
+	for (size_t i = 0; i < len_src; ++i)
+		padded[i] = src[i];
+
+	for (size_t i = len_src; i < space_size - 1; ++i)
+		padded[i] = src[len_src - 1];
+
+	return padded;
+}
+
+// hash of a key for the hashed companions of search::index, the finalizer of MurmurHash3 over the bits of the key;
+// keys that compare equal despite distinct representations, i.e. floating-point zeros, hash alike
+template < typename KEY_T >
+inline uint64_t key_hash(
+	const KEY_T key)
+{
+	const KEY_T k = KEY_T() == key ? KEY_T() : key;
+	uint64_t x = 0;
+	memcpy(&x, &k, sizeof(k) < sizeof(x) ? sizeof(k) : sizeof(x));
+
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+
+	return x;
+}
+
+// per-layout policies of search::index: space_size() is the size parameter the search routines of the layout
+// take, storage_size() the item count of the laid-out space, item_count() the count of sorted items therein,
+// padding included, position_map maps the sorted positions of a space to layout positions, finish() completes a
+// space whose items were stored by a position_map, slots holding no item included, so that spaces of the same
+// keys are byte-identical however built, lower_bound() returns the sorted rank of the key and the layout position
+// of the lower-bound item, upper_bound() does the same for the upper bound, lower_bound_batch() does what lower_bound()
+// does for a group of keys
+template < typename LAYOUT_T >
+struct layout_traits;
+
+template <>
+struct layout_traits< layout_standard >
+{
+	static size_t space_size(
+		const size_t len)
+	{
+		return len;
+	}
+
+	static size_t storage_size(
+		const size_t space_size)
+	{
+		return space_size;
+	}
+
+	static size_t item_count(
+		const size_t space_size)
+	{
+		return space_size;
+	}
+
+	struct position_map {
+		explicit position_map(
+			const size_t)
+		{
+		}
+
+		size_t operator ()(
+			const size_t pos) const
+		{
+			return pos;
+		}
+	};
+
+	template < typename KEY_T >
+	static void finish(
+		KEY_T* const,
+		const size_t)
+	{
+	}
+
+	template < typename KEY_T >
+	static size_t build(
+		KEY_T* const dst,
+		const size_t,
+		const KEY_T* const src,
+		const size_t len_src,
+		const size_t)
+	{
+		for (size_t i = 0; i < len_src; ++i)
+			dst[i] = src[i];
+
+		return 1;
+	}
+
+	template < typename KEY_T >
+	static size_t lower_bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		return pos = blowerbound_standard(space, space_size, key);
+	}
+
+	template < typename KEY_T >
+	static size_t upper_bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		return pos = bupperbound_standard(space, space_size, key);
+	}
+
+	template < size_t GROUP_SIZE, typename KEY_T >
+	static void lower_bound_batch(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T* const key,
+		size_t* const rank,
+		size_t* const pos)
+	{
+		blowerbound_standard_batch< GROUP_SIZE >(space, space_size, key, rank);
+
+		for (size_t g = 0; g < GROUP_SIZE; ++g)
+			pos[g] = rank[g];
+	}
+};
+
+template < size_t LEADIN_SIZE >
+struct layout_traits< layout_binned< LEADIN_SIZE > >
+{
+	static size_t space_size(
+		const size_t len)
+	{
+		return len;
+	}
+
+	static size_t storage_size(
+		const size_t space_size)
+	{
+		return LEADIN_SIZE + space_size;
+	}
+
+	static size_t item_count(
+		const size_t space_size)
+	{
+		return space_size;
+	}
+
+	struct position_map {
+		explicit position_map(
+			const size_t)
+		{
+		}
+
+		size_t operator ()(
+			const size_t pos) const
+		{
+			return LEADIN_SIZE + pos;
+		}
+	};
+
+	template < typename KEY_T >
+	static void finish(
+		KEY_T* const dst,
+		const size_t space_size)
+	{
+		prepare_for_binned_search(dst, LEADIN_SIZE, dst + LEADIN_SIZE, space_size);
+	}
+
+	template < typename KEY_T >
+	static size_t build(
+		KEY_T* const dst,
+		const size_t,
+		const KEY_T* const src,
+		const size_t len_src,
+		const size_t)
+	{
+		for (size_t i = 0; i < len_src; ++i)
+			dst[LEADIN_SIZE + i] = src[i];
+
+		prepare_for_binned_search(dst, LEADIN_SIZE, dst + LEADIN_SIZE, len_src);
+		return 1;
+	}
+
+	template < typename KEY_T >
+	static size_t lower_bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		const size_t rank = blowerbound_binned< LEADIN_SIZE >(space, space + LEADIN_SIZE, space_size, key);
+
+		pos = LEADIN_SIZE + rank;
+		return rank;
+	}
+
+	template < typename KEY_T >
+	static size_t upper_bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		const size_t rank = bupperbound_binned< LEADIN_SIZE >(space, space + LEADIN_SIZE, space_size, key);
+
+		pos = LEADIN_SIZE + rank;
+		return rank;
+	}
+
+	// the leadin scan does not lend itself to lockstep search
+	template < size_t GROUP_SIZE, typename KEY_T >
+	static void lower_bound_batch(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T* const key,
+		size_t* const rank,
+		size_t* const pos)
+	{
+		for (size_t g = 0; g < GROUP_SIZE; ++g)
+			rank[g] = lower_bound(space, space_size, key[g], pos[g]);
+	}
+};
+
+template <>
+struct layout_traits< layout_breadth >
+{
+	static size_t space_size(
+		const size_t len)
+	{
+		return tree_space_size(len);
+	}
+
+	static size_t storage_size(
+		const size_t space_size)
+	{
+		return space_size;
+	}
+
+	static size_t item_count(
+		const size_t space_size)
+	{
+		return space_size - 1;
+	}
+
+	struct position_map {
+		size_t space_size;
+
+		explicit position_map(
+			const size_t space_size)
+		: space_size(space_size)
+		{
+		}
+
+		size_t operator ()(
+			const size_t pos) const
+		{
+			return breadth_from_linear(space_size, pos);
+		}
+	};
+
+	// zero the slot past the tree
+	template < typename KEY_T >
+	static void finish(
+		KEY_T* const dst,
+		const size_t space_size)
+	{
+		dst[space_size - 1] = 0;
+	}
+
+	template < typename KEY_T >
+	static size_t build(
+		KEY_T* const dst,
+		const size_t len_dst,
+		const KEY_T* const src,
+		const size_t len_src,
+		const size_t space_size)
+	{
+		aligned_ptr< KEY_T, bsearch_ROUTINE_ALIGNMENT > padded;
+		const KEY_T* const tree = pad_for_tree(padded, src, len_src, space_size);
+
+		if (0 == tree || !prepare_for_breadth_search(dst, len_dst, tree, space_size))
+			return 0;
+
+		finish(dst, space_size);
+		return 1;
+	}
+
+	template < typename KEY_T >
+	static size_t lower_bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		return blowerbound_breadth(space, space_size, key, pos);
+	}
+
+	template < typename KEY_T >
+	static size_t upper_bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		return bupperbound_breadth(space, space_size, key, pos);
+	}
+
+	template < size_t GROUP_SIZE, typename KEY_T >
+	static void lower_bound_batch(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T* const key,
+		size_t* const rank,
+		size_t* const pos)
+	{
+		blowerbound_breadth_batch< GROUP_SIZE >(space, space_size, key, rank, pos);
+	}
+};
+
+template < size_t LOG2_SUBSIZE >
+struct layout_traits< layout_veb< LOG2_SUBSIZE > >
+{
+	static size_t space_size(
+		const size_t len)
+	{
+		return tree_space_size(len);
+	}
+
+	static size_t storage_size(
+		const size_t space_size)
+	{
+		return veb_total_size(space_size, size_t(1) << LOG2_SUBSIZE);
+	}
+
+	static size_t item_count(
+		const size_t space_size)
+	{
+		return space_size - 1;
+	}
+
+	// veb_from_linear with the per-level terms tabulated
+	struct position_map {
+		size_t base[64];        // per bottom-up level: layout position of the leftmost item of the level
+		uint8_t tree_shift[64]; // per bottom-up level: log2 of the count of sorted positions spanned by a tree
+
+		explicit position_map(
+			const size_t space_size)
+		{
+			const size_t log2_size = log2_from_pot(space_size);
+			const size_t log2_top = veb_top_level(log2_size, LOG2_SUBSIZE);
+
+			for (size_t level = 0; level < log2_size; ++level) {
+				const size_t top_down = log2_size - 1 - level;
+				const size_t depth = top_down < log2_top ? 0 :
+					log2_top + (top_down - log2_top) / LOG2_SUBSIZE * LOG2_SUBSIZE;
+
+				base[level] = veb_from_linear(space_size, LOG2_SUBSIZE, (size_t(1) << level) - 1);
+				tree_shift[level] = uint8_t(log2_size - depth);
+			}
+		}
+
+		size_t operator ()(
+			const size_t pos) const
+		{
+			const size_t level = bitscan(int64_t(~pos)) - 1;
+			const size_t shift = tree_shift[level];
+
+			return base[level] + (pos >> shift << LOG2_SUBSIZE) + ((pos & (size_t(1) << shift) - 1) >> level + 1);
+		}
+	};
+
+	// zero the padding of each tree to the subtree size, as prepare_for_veb_search does
+	template < typename KEY_T >
+	static void finish(
+		KEY_T* const dst,
+		const size_t space_size)
+	{
+		const size_t subsize = size_t(1) << LOG2_SUBSIZE;
+		const size_t num_tree = storage_size(space_size) >> LOG2_SUBSIZE;
+		const size_t log2_top = veb_top_level(log2_from_pot(space_size), LOG2_SUBSIZE);
+
+		for (size_t i = (size_t(1) << log2_top) - 1; i < subsize; ++i)
+			dst[i] = 0;
+
+		for (size_t t = 1; t < num_tree; ++t)
+			dst[t * subsize + subsize - 1] = 0;
+	}
+
+	template < typename KEY_T >
+	static size_t build(
+		KEY_T* const dst,
+		const size_t len_dst,
+		const KEY_T* const src,
+		const size_t len_src,
+		const size_t space_size)
+	{
+		aligned_ptr< KEY_T, bsearch_ROUTINE_ALIGNMENT > padded;
+		const KEY_T* const tree = pad_for_tree(padded, src, len_src, space_size);
+
+		return 0 != tree && prepare_for_veb_search(dst, len_dst, tree, space_size, size_t(1) << LOG2_SUBSIZE);
+	}
+
+	template < typename KEY_T >
+	static size_t lower_bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		return blowerbound_veb< LOG2_SUBSIZE >(space, space_size, key, pos);
+	}
+
+	template < typename KEY_T >
+	static size_t upper_bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		return bupperbound_veb< LOG2_SUBSIZE >(space, space_size, key, pos);
+	}
+
+	template < size_t GROUP_SIZE, typename KEY_T >
+	static void lower_bound_batch(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T* const key,
+		size_t* const rank,
+		size_t* const pos)
+	{
+		blowerbound_veb_batch< LOG2_SUBSIZE, GROUP_SIZE >(space, space_size, key, rank, pos);
+	}
+};
+
+// Order-preserving 16-bit quantisation of keys over the key range of a space: keys map to prefixes that compare as
+// the keys do, save that distinct keys may share a prefix; a tie thus calls for a comparison of the full keys.
+// Prefixes of keys and of the items they are compared against must come from the same code, as they do here.
+struct key_quantizer {
+	double min;
+	double scale;
+
+	template < typename KEY_T >
+	void init(
+		const KEY_T lo,
+		const KEY_T hi)
+	{
+		const double range = double(hi) - double(lo);
+
+		min = double(lo);
+		scale = range > 0 ? 65535.0 / range : 0;
+	}
+
+	template < typename KEY_T >
+	uint16_t operator ()(
+		const KEY_T key) const
+	{
+		const double x = (double(key) - min) * scale;
+		return x > 0 ? (x < 65535 ? uint16_t(x) : uint16_t(65535)) : uint16_t(0);
+	}
+};
+
+// Storage of the prefix layouts: the quantizer of the space, then the prefixes of the first slots of the base
+// layout, each region padded to a cache line, then the base layout itself, so that the full items of the prefixed
+// slots remain at hand for ties.
+template < typename KEY_T >
+struct prefix_storage
+{
+	static size_t header_size()
+	{
+		return (sizeof(key_quantizer) + CACHELINE_SIZE - 1) / CACHELINE_SIZE * CACHELINE_SIZE / sizeof(KEY_T);
+	}
+
+	// item count ahead of the base layout
+	static size_t offset(
+		const size_t num_prefix)
+	{
+		return header_size() + (num_prefix * sizeof(uint16_t) + CACHELINE_SIZE - 1) / CACHELINE_SIZE * CACHELINE_SIZE / sizeof(KEY_T);
+	}
+
+	static key_quantizer quantizer(
+		const KEY_T* const space)
+	{
+		key_quantizer q;
+		memcpy(&q, space, sizeof(q));
+		return q;
+	}
+
+	static const uint16_t* prefix(
+		const KEY_T* const space)
+	{
+		return reinterpret_cast< const uint16_t* >(space + header_size());
+	}
+
+	// store the quantizer for the key range [lo, hi] and the prefixes of the first slots of the base layout
+	static void prepare(
+		KEY_T* const dst,
+		const size_t num_prefix,
+		const KEY_T lo,
+		const KEY_T hi)
+	{
+		key_quantizer q;
+		q.init(lo, hi);
+
+		// zero the padding of both regions too, so that storage is the same whatever it held before
+		memset(dst, 0, offset(num_prefix) * sizeof(KEY_T));
+		memcpy(dst, &q, sizeof(q));
+
+		const KEY_T* const base = dst + offset(num_prefix);
+		uint16_t* const prefix = reinterpret_cast< uint16_t* >(dst + header_size());
+
+		for (size_t i = 0; i < num_prefix; ++i)
+			prefix[i] = q(base[i]);
+	}
+};
+
+// layout_traits of a layout for a key type: those of the layout, save for layouts whose storage depends on the key
+// type, which specialise the whole
+template < typename LAYOUT_T, typename KEY_T >
+struct keyed_layout_traits : layout_traits< LAYOUT_T > {};
+
+// Breadth-first layout with the top PREFIX_LEVELS levels mirrored by key prefixes.
+template < size_t PREFIX_LEVELS, typename KEY_T >
+struct keyed_layout_traits< layout_prefix< layout_breadth, PREFIX_LEVELS >, KEY_T >
+{
+	typedef layout_traits< layout_breadth > base;
+	typedef prefix_storage< KEY_T > region;
+
+	static size_t num_prefix(
+		const size_t space_size)
+	{
+		const size_t log2_size = log2_from_pot(space_size);
+		return (size_t(1) << (PREFIX_LEVELS < log2_size ? PREFIX_LEVELS : log2_size)) - 1;
+	}
+
+	static size_t space_size(
+		const size_t len)
+	{
+		return base::space_size(len);
+	}
+
+	static size_t storage_size(
+		const size_t space_size)
+	{
+		return region::offset(num_prefix(space_size)) + base::storage_size(space_size);
+	}
+
+	static size_t item_count(
+		const size_t space_size)
+	{
+		return base::item_count(space_size);
+	}
+
+	struct position_map {
+		base::position_map map;
+		size_t offset;
+
+		explicit position_map(
+			const size_t space_size)
+		: map(space_size)
+		, offset(region::offset(num_prefix(space_size)))
+		{
+		}
+
+		size_t operator ()(
+			const size_t pos) const
+		{
+			return offset + map(pos);
+		}
+	};
+
+	static void finish(
+		KEY_T* const dst,
+		const size_t space_size)
+	{
+		const position_map map(space_size);
+
+		base::finish(dst + map.offset, space_size);
+		region::prepare(dst, num_prefix(space_size), dst[map(0)], dst[map(item_count(space_size) - 1)]);
+	}
+
+	static size_t build(
+		KEY_T* const dst,
+		const size_t len_dst,
+		const KEY_T* const src,
+		const size_t len_src,
+		const size_t space_size)
+	{
+		const size_t offset = region::offset(num_prefix(space_size));
+
+		if (!base::build(dst + offset, len_dst - offset, src, len_src, space_size))
+			return 0;
+
+		region::prepare(dst, num_prefix(space_size), src[0], src[len_src - 1]);
+		return 1;
+	}
+
+	template < bool UPPER >
+	static size_t bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		const size_t n = num_prefix(space_size);
+		const size_t offset = region::offset(n);
+		const size_t rank = bbound_breadth_prefix< UPPER >(region::prefix(space), n, region::quantizer(space)(key),
+			space + offset, space_size, key, pos);
+
+		pos += offset;
+		return rank;
+	}
+
+	static size_t lower_bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		return bound< false >(space, space_size, key, pos);
+	}
+
+	static size_t upper_bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		return bound< true >(space, space_size, key, pos);
+	}
+
+	// the prefix ties do not lend themselves to lockstep search
+	template < size_t GROUP_SIZE >
+	static void lower_bound_batch(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T* const key,
+		size_t* const rank,
+		size_t* const pos)
+	{
+		for (size_t g = 0; g < GROUP_SIZE; ++g)
+			rank[g] = lower_bound(space, space_size, key[g], pos[g]);
+	}
+};
+
+// VEB layout with the trees of the macro levels within the top PREFIX_LEVELS levels mirrored by key prefixes, at
+// least the top tree, so that prefixes span whole subtrees, as laid out by prepare_for_veb_search.
+template < size_t LOG2_SUBSIZE, size_t PREFIX_LEVELS, typename KEY_T >
+struct keyed_layout_traits< layout_prefix< layout_veb< LOG2_SUBSIZE >, PREFIX_LEVELS >, KEY_T >
+{
+	typedef layout_traits< layout_veb< LOG2_SUBSIZE > > base;
+	typedef prefix_storage< KEY_T > region;
+
+	static size_t num_macro(
+		const size_t space_size)
+	{
+		const size_t log2_size = log2_from_pot(space_size);
+		return (log2_size - veb_top_level(log2_size, LOG2_SUBSIZE)) / LOG2_SUBSIZE + 1;
+	}
+
+	static size_t num_prefix_macro(
+		const size_t space_size)
+	{
+		const size_t log2_top = veb_top_level(log2_from_pot(space_size), LOG2_SUBSIZE);
+		const size_t n = PREFIX_LEVELS > log2_top ? (PREFIX_LEVELS - log2_top) / LOG2_SUBSIZE + 1 : 1;
+		const size_t total = num_macro(space_size);
+
+		return n < total ? n : total;
+	}
+
+	// slot count of the trees of the prefixed macro levels
+	static size_t num_prefix(
+		const size_t space_size)
+	{
+		const size_t log2_top = veb_top_level(log2_from_pot(space_size), LOG2_SUBSIZE);
+		const size_t num_band = num_prefix_macro(space_size) - 1;
+		const size_t num_tree = 1 + (size_t(1) << log2_top) * ((size_t(1) << LOG2_SUBSIZE * num_band) - 1) /
+			((size_t(1) << LOG2_SUBSIZE) - 1);
+
+		return num_tree << LOG2_SUBSIZE;
+	}
+
+	static size_t space_size(
+		const size_t len)
+	{
+		return base::space_size(len);
+	}
+
+	static size_t storage_size(
+		const size_t space_size)
+	{
+		return region::offset(num_prefix(space_size)) + base::storage_size(space_size);
+	}
+
+	static size_t item_count(
+		const size_t space_size)
+	{
+		return base::item_count(space_size);
+	}
+
+	struct position_map {
+		typename base::position_map map;
+		size_t offset;
+
+		explicit position_map(
+			const size_t space_size)
+		: map(space_size)
+		, offset(region::offset(num_prefix(space_size)))
+		{
+		}
+
+		size_t operator ()(
+			const size_t pos) const
+		{
+			return offset + map(pos);
+		}
+	};
+
+	static void finish(
+		KEY_T* const dst,
+		const size_t space_size)
+	{
+		const position_map map(space_size);
+
+		base::finish(dst + map.offset, space_size);
+		region::prepare(dst, num_prefix(space_size), dst[map(0)], dst[map(item_count(space_size) - 1)]);
+	}
+
+	static size_t build(
+		KEY_T* const dst,
+		const size_t len_dst,
+		const KEY_T* const src,
+		const size_t len_src,
+		const size_t space_size)
+	{
+		const size_t offset = region::offset(num_prefix(space_size));
+
+		if (!base::build(dst + offset, len_dst - offset, src, len_src, space_size))
+			return 0;
+
+		region::prepare(dst, num_prefix(space_size), src[0], src[len_src - 1]);
+		return 1;
+	}
+
+	template < bool UPPER >
+	static size_t bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		const size_t log2_top = veb_top_level(log2_from_pot(space_size), LOG2_SUBSIZE);
+		const size_t offset = region::offset(num_prefix(space_size));
+		const size_t rank = bbound_van_emde_boas_prefix< UPPER >(region::prefix(space), num_prefix_macro(space_size),
+			region::quantizer(space)(key), space + offset, key, LOG2_SUBSIZE, log2_top, num_macro(space_size), pos);
+
+		pos += offset;
+		return rank;
+	}
+
+	static size_t lower_bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		return bound< false >(space, space_size, key, pos);
+	}
+
+	static size_t upper_bound(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T key,
+		size_t& pos)
+	{
+		return bound< true >(space, space_size, key, pos);
+	}
+
+	// the prefix ties do not lend themselves to lockstep search
+	template < size_t GROUP_SIZE >
+	static void lower_bound_batch(
+		const KEY_T* const space,
+		const size_t space_size,
+		const KEY_T* const key,
+		size_t* const rank,
+		size_t* const pos)
+	{
+		for (size_t g = 0; g < GROUP_SIZE; ++g)
+			rank[g] = lower_bound(space, space_size, key[g], pos[g]);
+	}
+};
+
+// A sorted set of keys laid out for search in any of the above layouts. The index owns its laid-out storage and
+// answers all queries in terms of sorted positions, so results are identical across layouts; keys need not be
+// unique, nor their count a power of two. An index not yet built, or whose first build failed, is empty: it finds
+// no key, and its cursors are not valid.
+template < typename KEY_T, typename LAYOUT_T, size_t ALIGNMENT_T = bsearch_ROUTINE_ALIGNMENT >
+class index
+{
+	typedef keyed_layout_traits< LAYOUT_T, KEY_T > traits;
+
+	static const size_t group_size = 8; // number of keys searched in lockstep by the batch searches
+
+	aligned_ptr< KEY_T, ALIGNMENT_T > storage;
+	size_t num_key;
+	size_t space_size;
+	typename traits::position_map layout_position; // of the current space, for the cursors
+
+	index(
+		const index& src); // undefined
+
+	index& operator =(
+		const index& src); // undefined
+
+public:
+	typedef KEY_T key_type;
+	typedef LAYOUT_T layout_type;
+
+	static const size_t npos = size_t(-1);
+	static const size_t alignment = ALIGNMENT_T;
+
+	index()
+	: num_key(0)
+	, space_size(0)
+	, layout_position(traits::space_size(1))
+	{
+	}
+
+	// In-order cursor over the keys of an index, from a sorted position on. Each step maps the sorted position
+	// prefetch_distance positions ahead to its layout position, in constant time, and prefetches the item there,
+	// since successive items of the tree layouts are spread over all levels of the tree. Cursors are invalidated
+	// by build and merge.
+	class cursor
+	{
+		friend class index;
+
+		static const size_t prefetch_distance = 8; // power of two
+
+		const index* self;
+		size_t rank;
+		size_t ahead[prefetch_distance]; // layout positions of the next prefetch_distance sorted positions
+
+		void fetch(
+			const size_t r)
+		{
+			if (r < self->num_key) {
+				const size_t pos = self->layout_position(r);
+
+				__builtin_prefetch(static_cast< const KEY_T* >(self->storage) + pos);
+				ahead[r & prefetch_distance - 1] = pos;
+			}
+		}
+
+		cursor(
+			const index& src,
+			const size_t start)
+		: self(&src)
+		, rank(start)
+		{
+			for (size_t i = 0; i < prefetch_distance; ++i)
+				fetch(start + i);
+		}
+
+	public:
+		bool valid() const
+		{
+			return rank < self->num_key;
+		}
+
+		// sorted position of the current key
+		size_t position() const
+		{
+			return rank;
+		}
+
+		KEY_T key() const
+		{
+			return static_cast< const KEY_T* >(self->storage)[ahead[rank & prefetch_distance - 1]];
+		}
+
+		void next()
+		{
+			fetch(++rank + prefetch_distance - 1);
+		}
+	};
+
+	// build from an array of keys sorted in ascending order; return 0 on failure, leaving the index intact
+	size_t build(
+		const KEY_T* const src,
+		const size_t len_src)
+	{
+		if (0 == len_src)
+			return 0;
+
+		const size_t new_space_size = traits::space_size(len_src);
+		const size_t new_storage_size = traits::storage_size(new_space_size);
+		aligned_ptr< KEY_T, ALIGNMENT_T > new_storage(new_storage_size);
+
+		if (new_storage.is_null())
+			return 0;
+
+		if (!traits::build(static_cast< KEY_T* >(new_storage), new_storage_size, src, len_src, new_space_size))
+			return 0;
+
+		storage.move(new_storage);
+		num_key = len_src;
+		space_size = new_space_size;
+		layout_position = typename traits::position_map(new_space_size);
+
+		return 1;
+	}
+
+	// take over storage laid out for the specified count of keys by a builder of its own, which wrote the keys in
+	// sorted order through the position_map of the layout, padded as pad_for_tree does and completed the space by
+	// finish(); the storage is left null; return 0 on failure, leaving the index intact
+	size_t adopt(
+		aligned_ptr< KEY_T, ALIGNMENT_T >& laid_out,
+		const size_t len)
+	{
+		if (0 == len || laid_out.is_null())
+			return 0;
+
+		const size_t new_space_size = traits::space_size(len);
+
+		storage.move(laid_out);
+		num_key = len;
+		space_size = new_space_size;
+		layout_position = typename traits::position_map(new_space_size);
+
+		return 1;
+	}
+
+	// merge an array of keys sorted in ascending order into the index, in a single pass over the laid-out
+	// storage and the keys, reading and writing items in sorted order; keys equal to ones in the index go after
+	// those; no sorted copy of either is made; return 0 on failure, leaving the index intact
+	size_t merge(
+		const KEY_T* const src,
+		const size_t len_src)
+	{
+		if (0 == len_src)
+			return 1;
+
+		if (0 == num_key)
+			return build(src, len_src);
+
+		const size_t new_len = num_key + len_src;
+		const size_t new_space_size = traits::space_size(new_len);
+		const size_t new_item_count = traits::item_count(new_space_size);
+		aligned_ptr< KEY_T, ALIGNMENT_T > new_storage(traits::storage_size(new_space_size));
+
+		if (new_storage.is_null())
+			return 0;
+
+		const typename traits::position_map old_position(space_size);
+		const typename traits::position_map new_position(new_space_size);
+		const KEY_T* const old = storage;
+		KEY_T* const dst = new_storage;
+		size_t i = 0;
+		size_t j = 0;
+		KEY_T next_old = old[old_position(0)];
+		KEY_T last = next_old;
+
+		for (size_t r = 0; r < new_len; ++r) {
+			if (j == len_src || i < num_key && !(src[j] < next_old)) {
+				last = next_old;
+
+				if (++i < num_key)
+					next_old = old[old_position(i)];
+			}
+			else
+				last = src[j++];
+
+			dst[new_position(r)] = last;
+		}
+
+		// pad to a complete tree by repeating the last key, as pad_for_tree does
+		for (size_t r = new_len; r < new_item_count; ++r)
+			dst[new_position(r)] = last;
+
+		traits::finish(dst, new_space_size);
+
+		storage.move(new_storage);
+		num_key = new_len;
+		space_size = new_space_size;
+		layout_position = new_position;
+
+		return 1;
+	}
+
+	// number of keys in the index
+	size_t size() const
+	{
+		return num_key;
+	}
+
+	// number of items in the laid-out storage, padding included
+	size_t storage_size() const
+	{
+		return num_key ? traits::storage_size(space_size) : 0;
+	}
+
+	// the laid-out storage
+	const KEY_T* data() const
+	{
+		return storage;
+	}
+
+	// sorted position of the first occurrence of the key, or npos if the key is absent
+	size_t find(
+		const KEY_T key) const
+	{
+		if (0 == num_key)
+			return npos;
+
+		const KEY_T* const space = storage;
+		size_t pos;
+		const size_t rank = traits::lower_bound(space, space_size, key, pos);
+
+		return rank < num_key && space[pos] == key ? rank : npos;
+	}
+
+	// sorted position of the first key not less than the specified one, or size() if there is no such key
+	size_t lower_bound(
+		const KEY_T key) const
+	{
+		if (0 == num_key)
+			return 0;
+
+		size_t pos;
+		const size_t rank = traits::lower_bound(static_cast< const KEY_T* >(storage), space_size, key, pos);
+
+		return rank < num_key ? rank : num_key;
+	}
+
+	// sorted position of the first key greater than the specified one, or size() if there is no such key
+	size_t upper_bound(
+		const KEY_T key) const
+	{
+		if (0 == num_key)
+			return 0;
+
+		size_t pos;
+		const size_t rank = traits::upper_bound(static_cast< const KEY_T* >(storage), space_size, key, pos);
+
+		return rank < num_key ? rank : num_key;
+	}
+
+	// sorted positions of the first occurrence of the key and one past its last occurrence, both the lower bound
+	// of the key if it is absent
+	void equal_range(
+		const KEY_T key,
+		size_t& first,
+		size_t& last) const
+	{
+		first = lower_bound(key);
+		last = upper_bound(key);
+	}
+
+	// number of occurrences of the key
+	size_t count(
+		const KEY_T key) const
+	{
+		return upper_bound(key) - lower_bound(key);
+	}
+
+	// number of keys less than the specified one
+	size_t rank(
+		const KEY_T key) const
+	{
+		return lower_bound(key);
+	}
+
+	// number of keys in the range [lo, hi), by the ranks of the bounds, without visiting the keys
+	size_t count_range(
+		const KEY_T lo,
+		const KEY_T hi) const
+	{
+		const size_t first = lower_bound(lo);
+		const size_t last = lower_bound(hi);
+
+		return last > first ? last - first : 0;
+	}
+
+	// cursor at the specified sorted position
+	cursor at(
+		const size_t rank) const
+	{
+		return cursor(*this, rank);
+	}
+
+	// cursor at the lower bound of the key, i.e. at the first key of the range starting with the key
+	cursor scan(
+		const KEY_T key) const
+	{
+		return cursor(*this, lower_bound(key));
+	}
+
+	// batch versions of the above; results are written to the array of the same count as the keys; keys are
+	// searched in lockstep groups where the layout allows
+
+	void find(
+		const KEY_T* const key,
+		const size_t count,
+		size_t* const result) const
+	{
+		const KEY_T* const space = storage;
+		size_t i = 0;
+
+		if (0 == num_key) {
+			for (; i < count; ++i)
+				result[i] = npos;
+
+			return;
+		}
+
+		for (; i + group_size <= count; i += group_size) {
+			size_t pos[group_size];
+
+			traits::template lower_bound_batch< group_size >(space, space_size, key + i, result + i, pos);
+
+			for (size_t g = 0; g < group_size; ++g)
+				result[i + g] = result[i + g] < num_key && space[pos[g]] == key[i + g] ? result[i + g] : npos;
+		}
+
+		for (; i < count; ++i)
+			result[i] = find(key[i]);
+	}
+
+	void lower_bound(
+		const KEY_T* const key,
+		const size_t count,
+		size_t* const result) const
+	{
+		const KEY_T* const space = storage;
+		size_t i = 0;
+
+		if (0 == num_key) {
+			for (; i < count; ++i)
+				result[i] = 0;
+
+			return;
+		}
+
+		for (; i + group_size <= count; i += group_size) {
+			size_t pos[group_size];
+
+			traits::template lower_bound_batch< group_size >(space, space_size, key + i, result + i, pos);
+
+			for (size_t g = 0; g < group_size; ++g)
+				result[i + g] = result[i + g] < num_key ? result[i + g] : num_key;
+		}
+
+		for (; i < count; ++i)
+			result[i] = lower_bound(key[i]);
+	}
+
+	void rank(
+		const KEY_T* const key,
+		const size_t count,
+		size_t* const result) const
+	{
+		lower_bound(key, count, result);
+	}
+};
+
 } // namespace search
 
 #undef bsearch_ROUTINE_ALIGNMENT
@@ -1,6 +1,6 @@
 #!/bin/bash
 
-BUILD_COMMON="-o test_bsearch main.cpp rand.cpp"
+BUILD_COMMON="-o test_bsearch main.cpp rand.cpp -pthread"
 
 if [[ ${MACHTYPE} =~ "-apple-darwin" ]]; then :
 	# Darwin has its timer framework linked in by default
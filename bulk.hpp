@@ -0,0 +1,104 @@
+#ifndef bulk_H__
+#define bulk_H__
+
+#include "thread_pool.hpp"
+
+namespace search {
+
+static const size_t bulk_chunk_size = 1 << 12; // number of keys per unit of work of a bulk search
+
+template < typename INDEX_T >
+struct bulk_job
+{
+	typedef typename INDEX_T::key_type key_type;
+
+	const INDEX_T* index;
+	const INDEX_T* const* worker_index; // index of each worker, or null to use the above by all workers
+	const key_type* key;
+	size_t count;
+	size_t* result;
+
+	static void find(
+		void* const arg,
+		const size_t chunk,
+		const size_t worker)
+	{
+		const bulk_job& job = *reinterpret_cast< const bulk_job* >(arg);
+		const INDEX_T& index = job.worker_index ? *job.worker_index[worker] : *job.index;
+		const size_t begin = chunk * bulk_chunk_size;
+		const size_t end = begin + bulk_chunk_size < job.count ? begin + bulk_chunk_size : job.count;
+
+		index.find(job.key + begin, end - begin, job.result + begin);
+	}
+
+	static void lower_bound(
+		void* const arg,
+		const size_t chunk,
+		const size_t worker)
+	{
+		const bulk_job& job = *reinterpret_cast< const bulk_job* >(arg);
+		const INDEX_T& index = job.worker_index ? *job.worker_index[worker] : *job.index;
+		const size_t begin = chunk * bulk_chunk_size;
+		const size_t end = begin + bulk_chunk_size < job.count ? begin + bulk_chunk_size : job.count;
+
+		index.lower_bound(job.key + begin, end - begin, job.result + begin);
+	}
+};
+
+// Search an array of keys in an index using all workers of the pool; the result of each key is written to the
+// same position in the result array, as by the batch searches of the index, so that no locking is needed.
+
+template < typename INDEX_T >
+inline void bulk_find(
+	thread_pool& pool,
+	const INDEX_T& index,
+	const typename INDEX_T::key_type* const key,
+	const size_t count,
+	size_t* const result)
+{
+	bulk_job< INDEX_T > job = { &index, 0, key, count, result };
+	pool.run(bulk_job< INDEX_T >::find, &job, (count + bulk_chunk_size - 1) / bulk_chunk_size);
+}
+
+template < typename INDEX_T >
+inline void bulk_lower_bound(
+	thread_pool& pool,
+	const INDEX_T& index,
+	const typename INDEX_T::key_type* const key,
+	const size_t count,
+	size_t* const result)
+{
+	bulk_job< INDEX_T > job = { &index, 0, key, count, result };
+	pool.run(bulk_job< INDEX_T >::lower_bound, &job, (count + bulk_chunk_size - 1) / bulk_chunk_size);
+}
+
+// As above, with each worker of the pool searching its own instance of the index, e.g. a replica local to the
+// NUMA node of the worker; the array holds one index pointer per worker.
+
+template < typename INDEX_T >
+inline void bulk_find(
+	thread_pool& pool,
+	const INDEX_T* const* const worker_index,
+	const typename INDEX_T::key_type* const key,
+	const size_t count,
+	size_t* const result)
+{
+	bulk_job< INDEX_T > job = { worker_index[0], worker_index, key, count, result };
+	pool.run(bulk_job< INDEX_T >::find, &job, (count + bulk_chunk_size - 1) / bulk_chunk_size);
+}
+
+template < typename INDEX_T >
+inline void bulk_lower_bound(
+	thread_pool& pool,
+	const INDEX_T* const* const worker_index,
+	const typename INDEX_T::key_type* const key,
+	const size_t count,
+	size_t* const result)
+{
+	bulk_job< INDEX_T > job = { worker_index[0], worker_index, key, count, result };
+	pool.run(bulk_job< INDEX_T >::lower_bound, &job, (count + bulk_chunk_size - 1) / bulk_chunk_size);
+}
+
+} // namespace search
+
+#endif // bulk_H__
@@ -0,0 +1,261 @@
+#ifndef cache_H__
+#define cache_H__
+
+#include <stdint.h>
+
+#include "aligned_ptr.hpp"
+#include "bsearch.hpp"
+
+namespace search {
+
+// A small set-associative cache of the results of exact-match searches, keyed by the search key, for skewed query
+// streams. Each set is guarded by a sequence lock: readers never write to the cache and never wait, treating a set
+// being written as a miss; writers give up on a set being written by another writer. A key is admitted on its
+// second miss in a row in its set, so that the keys queried once don't push the hot keys out; the ways of a set
+// hold the keys in order of admission, the oldest one evicted. Every entry is tagged, through its set, with the
+// generation of the cache, which invalidate() bumps, so that no result of an index before a rebuild is ever
+// returned after it; a writer admits a result under the generation sampled before the search that produced it.
+template < typename KEY_T, size_t LOG2_SETS = 10, size_t WAYS = 4 >
+class hot_cache
+{
+	static const size_t num_set = size_t(1) << LOG2_SETS;
+	static const uint32_t absent = uint32_t(-1); // cached position of keys absent from the index
+
+	struct entry {
+		KEY_T key;
+		uint32_t position;
+	};
+
+	struct set {
+		uint32_t sequence;   // odd while the set is being written
+		uint32_t generation; // of the entries of the set
+		uint32_t count;      // number of entries of the set
+		uint32_t candidate;  // fingerprint of the last key missed in the set, admitted on its next miss
+		entry way[WAYS];
+	} __attribute__ ((aligned(CACHELINE_SIZE)));
+
+	aligned_ptr< set, CACHELINE_SIZE > sets;
+	uint32_t current; // generation of the cache
+
+	hot_cache(
+		const hot_cache& src); // undefined
+
+	hot_cache& operator =(
+		const hot_cache& src); // undefined
+
+public:
+	static const size_t npos = size_t(-1);
+
+	hot_cache()
+	: sets(num_set)
+	, current(1)
+	{
+		for (size_t i = 0; i < num_set; ++i) {
+			sets[i].sequence = 0;
+			sets[i].generation = 0;
+			sets[i].count = 0;
+			sets[i].candidate = 0;
+		}
+	}
+
+	// number of bytes taken by the cache
+	size_t storage_bytes() const
+	{
+		return num_set * sizeof(set);
+	}
+
+	// current generation, to be sampled ahead of a search whose result is to be admitted
+	uint32_t generation() const
+	{
+		return __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+	}
+
+	// drop all entries, in constant time
+	void invalidate()
+	{
+		__atomic_fetch_add(&current, 1, __ATOMIC_ACQ_REL);
+	}
+
+	// true and the cached position of the key, or npos if the key is absent from the index, on a hit
+	bool lookup(
+		const KEY_T key,
+		size_t& pos) const
+	{
+		const uint64_t h = key_hash(key);
+		const set& s = sets[size_t(h) & num_set - 1];
+		const uint32_t seq = __atomic_load_n(&s.sequence, __ATOMIC_ACQUIRE);
+
+		if (seq & 1)
+			return false;
+
+		const uint32_t gen = __atomic_load_n(&s.generation, __ATOMIC_RELAXED);
+		const uint32_t count = __atomic_load_n(&s.count, __ATOMIC_RELAXED);
+		uint32_t position = 0;
+		bool hit = false;
+
+		for (size_t w = 0; w < WAYS && w < count; ++w) {
+			KEY_T k;
+			__atomic_load(&s.way[w].key, &k, __ATOMIC_RELAXED);
+
+			if (k == key) {
+				position = __atomic_load_n(&s.way[w].position, __ATOMIC_RELAXED);
+				hit = true;
+				break;
+			}
+		}
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		if (!hit || __atomic_load_n(&s.sequence, __ATOMIC_RELAXED) != seq || gen != generation())
+			return false;
+
+		pos = absent == position ? npos : position;
+		return true;
+	}
+
+	// offer the position of a key, or npos if the key is absent from the index, as found by a search that started
+	// at the specified generation; positions past 32 bits are not cached
+	void admit(
+		const KEY_T key,
+		const size_t pos,
+		const uint32_t gen)
+	{
+		if (npos != pos && size_t(absent) <= pos)
+			return;
+
+		const uint64_t h = key_hash(key);
+		set& s = sets[size_t(h) & num_set - 1];
+		uint32_t seq = __atomic_load_n(&s.sequence, __ATOMIC_RELAXED);
+
+		if (seq & 1 || !__atomic_compare_exchange_n(&s.sequence, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return;
+
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+
+		const uint32_t fingerprint = uint32_t(h >> 32) | 1;
+
+		if (gen == generation()) {
+			if (__atomic_load_n(&s.generation, __ATOMIC_RELAXED) != gen) {
+				__atomic_store_n(&s.generation, gen, __ATOMIC_RELAXED);
+				__atomic_store_n(&s.count, 0, __ATOMIC_RELAXED);
+				__atomic_store_n(&s.candidate, 0, __ATOMIC_RELAXED);
+			}
+
+			if (__atomic_load_n(&s.candidate, __ATOMIC_RELAXED) != fingerprint)
+				__atomic_store_n(&s.candidate, fingerprint, __ATOMIC_RELAXED);
+			else {
+				const uint32_t count = __atomic_load_n(&s.count, __ATOMIC_RELAXED);
+				const uint32_t position = npos == pos ? absent : uint32_t(pos);
+
+				for (size_t w = count < WAYS ? count : WAYS - 1; w > 0; --w) {
+					KEY_T k;
+					__atomic_load(&s.way[w - 1].key, &k, __ATOMIC_RELAXED);
+					__atomic_store(&s.way[w].key, &k, __ATOMIC_RELAXED);
+					__atomic_store_n(&s.way[w].position, __atomic_load_n(&s.way[w - 1].position, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+				}
+
+				KEY_T k = key;
+				__atomic_store(&s.way[0].key, &k, __ATOMIC_RELAXED);
+				__atomic_store_n(&s.way[0].position, position, __ATOMIC_RELAXED);
+				__atomic_store_n(&s.count, count < WAYS ? count + 1 : uint32_t(WAYS), __ATOMIC_RELAXED);
+				__atomic_store_n(&s.candidate, 0, __ATOMIC_RELAXED);
+			}
+		}
+
+		__atomic_store_n(&s.sequence, seq + 2, __ATOMIC_RELEASE);
+	}
+};
+
+// A search::index with a hot_cache of the results of its exact-match searches in front; build and merge
+// invalidate the cache. The searches are safe to run from multiple threads, as long as no build or merge runs.
+template < typename KEY_T, typename LAYOUT_T, size_t LOG2_SETS = 10 >
+class cached_index
+{
+	index< KEY_T, LAYOUT_T > base;
+	mutable hot_cache< KEY_T, LOG2_SETS > cache;
+
+	cached_index(
+		const cached_index& src); // undefined
+
+	cached_index& operator =(
+		const cached_index& src); // undefined
+
+public:
+	typedef KEY_T key_type;
+	typedef LAYOUT_T layout_type;
+
+	static const size_t npos = size_t(-1);
+
+	cached_index()
+	{
+	}
+
+	// as by search::index
+	size_t build(
+		const KEY_T* const src,
+		const size_t len_src)
+	{
+		const size_t success = base.build(src, len_src);
+
+		cache.invalidate();
+		return success;
+	}
+
+	// as by search::index
+	size_t merge(
+		const KEY_T* const src,
+		const size_t len_src)
+	{
+		const size_t success = base.merge(src, len_src);
+
+		cache.invalidate();
+		return success;
+	}
+
+	// number of keys in the index
+	size_t size() const
+	{
+		return base.size();
+	}
+
+	// number of bytes taken by the cache
+	size_t cache_bytes() const
+	{
+		return cache.storage_bytes();
+	}
+
+	// as by search::index, telling whether the result came from the cache
+	size_t find(
+		const KEY_T key,
+		bool& hit) const
+	{
+		size_t pos;
+
+		if ((hit = cache.lookup(key, pos)))
+			return pos;
+
+		const uint32_t gen = cache.generation();
+
+		pos = base.find(key);
+		cache.admit(key, pos, gen);
+
+		return pos;
+	}
+
+	size_t find(
+		const KEY_T key) const
+	{
+		bool hit;
+		return find(key, hit);
+	}
+
+	size_t lower_bound(
+		const KEY_T key) const
+	{
+		return base.lower_bound(key);
+	}
+};
+
+} // namespace search
+
+#endif // cache_H__
@@ -0,0 +1,272 @@
+#ifndef calibrate_H__
+#define calibrate_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "timer.h"
+#include "aligned_ptr.hpp"
+#include "rand.hpp"
+
+// Memory profile of the host, as measured: the latency of dependent loads over working sets growing by factors
+// of four from within the first-level cache to well past the last, and the bandwidth of a streaming read of the
+// largest. Latencies come from a pointer chase along a random cycle through one word per cache line, so that
+// neither the prefetchers nor the memory-level parallelism of the core can hide them; past the caches they include
+// the TLB misses a search of the same working set would take. Cache sizes are read from sysfs where available.
+class memory_profile
+{
+public:
+	static const size_t num_cache = 3;  // data cache levels reported
+	static const size_t max_point = 16; // working sets measured
+
+private:
+	static const size_t min_footprint = 16 << 10;
+	static const size_t min_memory_footprint = 256 << 20; // least working set past the last-level cache
+	static const size_t max_memory_footprint = 1 << 30;
+	static const size_t chase_steps = 1 << 20; // number of dependent loads per latency measurement
+
+	size_t cache_bytes[num_cache]; // 0 if unknown
+	size_t footprint[max_point];
+	double latency[max_point]; // ns per dependent load
+	size_t num_point;
+	double bandwidth;          // bytes per s
+	bool valid;
+
+	// size of the data or unified cache of the level of cpu0, or 0 if unknown
+	static size_t cache_size(
+		const size_t level)
+	{
+		for (size_t i = 0; i < 8; ++i) {
+			char path[128];
+			unsigned lvl = 0;
+			char type[32] = "";
+			unsigned long size = 0;
+			char unit = 0;
+
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/level", unsigned(i));
+			FILE* f = fopen(path, "r");
+
+			if (0 == f)
+				break;
+
+			const bool read_level = 1 == fscanf(f, "%u", &lvl);
+			fclose(f);
+
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/type", unsigned(i));
+			f = fopen(path, "r");
+
+			if (0 == f)
+				continue;
+
+			const bool read_type = 1 == fscanf(f, "%31s", type);
+			fclose(f);
+
+			if (!read_level || !read_type || level != lvl || 'I' == type[0])
+				continue;
+
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/size", unsigned(i));
+			f = fopen(path, "r");
+
+			if (0 == f)
+				continue;
+
+			const int n = fscanf(f, "%lu%c", &size, &unit);
+			fclose(f);
+
+			if (1 > n)
+				continue;
+
+			return 'K' == unit ? size_t(size) << 10 : 'M' == unit ? size_t(size) << 20 : size_t(size);
+		}
+
+		return 0;
+	}
+
+	// ns per load of a chase through the specified number of bytes
+	static double chase(
+		const size_t bytes,
+		unsigned& seed)
+	{
+		const size_t stride = CACHELINE_SIZE / sizeof(size_t);
+		const size_t num_line = bytes / CACHELINE_SIZE;
+		aligned_ptr< size_t, CACHELINE_SIZE > line(num_line * stride);
+		aligned_ptr< size_t, CACHELINE_SIZE > order(num_line);
+
+		// a random cyclic order of the lines, by Sattolo's shuffle
+		for (size_t i = 0; i < num_line; ++i)
+			order[i] = i;
+
+		for (size_t i = num_line - 1; i > 0; --i) {
+			const size_t j = size_t(rnd::rand_r(&seed)) % i;
+			const size_t t = order[i];
+			order[i] = order[j];
+			order[j] = t;
+		}
+
+		for (size_t i = 0; i < num_line; ++i)
+			line[order[i] * stride] = order[(i + 1) % num_line] * stride;
+
+		// up to a lap to warm up, then the timed chase
+		size_t pos = 0;
+
+		for (size_t i = 0; i < num_line && i < chase_steps; ++i)
+			pos = line[pos];
+
+		const uint64_t t0 = timer_ns();
+
+		for (size_t i = 0; i < chase_steps; ++i)
+			pos = line[pos];
+
+		const uint64_t dt = timer_ns() - t0;
+
+		// keep the chase from being optimised away
+		__asm__ __volatile__ ("" : : "r" (pos));
+
+		return double(dt) / chase_steps;
+	}
+
+	// bytes per s of a streaming read of the specified number of bytes, best of a few passes
+	static double stream(
+		const size_t bytes)
+	{
+		const size_t count = bytes / sizeof(uint64_t);
+		aligned_ptr< uint64_t, CACHELINE_SIZE > buffer(count);
+		uint64_t best = uint64_t(-1);
+
+		for (size_t i = 0; i < count; ++i)
+			buffer[i] = i;
+
+		for (size_t pass = 0; pass < 3; ++pass) {
+			uint64_t sum = 0;
+			const uint64_t t0 = timer_ns();
+
+			for (size_t i = 0; i < count; ++i)
+				sum += buffer[i];
+
+			const uint64_t dt = timer_ns() - t0;
+
+			__asm__ __volatile__ ("" : : "r" (sum));
+
+			if (dt < best)
+				best = dt;
+		}
+
+		return best ? bytes * 1e9 / best : 0;
+	}
+
+public:
+	memory_profile()
+	: num_point(0)
+	, bandwidth(0)
+	, valid(false)
+	{
+	}
+
+	// measure the host; takes a few seconds
+	void calibrate()
+	{
+		unsigned seed = 42;
+		const size_t llc = last_cache_size();
+
+		for (size_t i = 0; i < num_cache; ++i)
+			cache_bytes[i] = cache_size(i + 1);
+
+		const size_t memory_footprint = 2 * llc < min_memory_footprint ? min_memory_footprint :
+			2 * llc < max_memory_footprint ? 2 * llc : max_memory_footprint;
+
+		num_point = 0;
+
+		for (size_t bytes = min_footprint; num_point < max_point; bytes *= 4) {
+			footprint[num_point] = bytes < memory_footprint ? bytes : memory_footprint;
+			latency[num_point] = chase(footprint[num_point], seed);
+
+			if (memory_footprint == footprint[num_point++])
+				break;
+		}
+
+		bandwidth = stream(footprint[num_point - 1]);
+		valid = true;
+	}
+
+	// size of the last-level data cache of cpu0, or 0 if unknown
+	static size_t last_cache_size()
+	{
+		size_t llc = 0;
+
+		for (size_t i = 0; i < num_cache; ++i) {
+			const size_t bytes = cache_size(i + 1);
+
+			if (bytes)
+				llc = bytes;
+		}
+
+		return llc;
+	}
+
+	bool calibrated() const
+	{
+		return valid;
+	}
+
+	// ns per dependent load past the caches
+	double memory_latency() const
+	{
+		return latency[num_point - 1];
+	}
+
+	// bytes per s
+	double memory_bandwidth() const
+	{
+		return bandwidth;
+	}
+
+	// ns per dependent load within a working set of the specified number of bytes, interpolated between the
+	// measured working sets by the log of the size
+	double latency_at(
+		const size_t bytes) const
+	{
+		if (bytes <= footprint[0])
+			return latency[0];
+
+		for (size_t i = 1; i < num_point; ++i)
+			if (bytes <= footprint[i]) {
+				const double f = log(double(bytes) / footprint[i - 1]) / log(double(footprint[i]) / footprint[i - 1]);
+				return latency[i - 1] + f * (latency[i] - latency[i - 1]);
+			}
+
+		return latency[num_point - 1];
+	}
+
+	// ns per search of a tree of the specified number of items, if every level is a dependent load within the
+	// working set of all levels of the tree down to it
+	double tree_latency(
+		const size_t num_item,
+		const size_t item_size) const
+	{
+		double ns = 0;
+		size_t level_items = 1;
+		size_t above = 0;
+
+		for (size_t covered = 0; covered < num_item; covered += level_items, level_items *= 2) {
+			above += level_items;
+			ns += latency_at((above < num_item ? above : num_item) * item_size);
+		}
+
+		return ns;
+	}
+
+	void print() const
+	{
+		for (size_t i = 0; i < num_cache; ++i)
+			if (cache_bytes[i])
+				printf("L%lu data cache: %lu KB\n", (unsigned long)(i + 1), (unsigned long)(cache_bytes[i] >> 10));
+
+		for (size_t i = 0; i < num_point; ++i)
+			printf("load latency over %lu KB: %.1f ns\n", (unsigned long)(footprint[i] >> 10), latency[i]);
+
+		printf("memory read bandwidth: %.2f GB/s\n", bandwidth * 1e-9);
+	}
+};
+
+#endif // calibrate_H__
@@ -0,0 +1,182 @@
+#ifndef hash_H__
+#define hash_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "aligned_ptr.hpp"
+#include "bsearch.hpp"
+
+namespace search {
+
+// An open-addressing hash table of the positions of the keys of an array, for exact-match searches only, as a
+// reference for the comparison layouts. Slots come in groups of 16, each group with a vector of 16 control bytes:
+// a clear top bit marks a full slot, the low 7 bits holding a tag of the hash of its key. A search matches its tag
+// against all control bytes of a group at once and compares the keys of the matching slots only; groups are
+// probed quadratically until one with an empty slot. The table is at most 7/8 full.
+template < typename KEY_T >
+class hash_index
+{
+	typedef uint8_t control __attribute__ ((vector_size(16)));
+	typedef char char_control __attribute__ ((vector_size(16)));
+
+	static const size_t group_size = sizeof(control);
+	static const uint8_t empty = 0x80;
+
+	struct entry {
+		KEY_T key;
+		uint32_t position;
+	};
+
+	aligned_ptr< control, CACHELINE_SIZE > ctrl;
+	aligned_ptr< entry, CACHELINE_SIZE > slot;
+	size_t num_group;
+	size_t num_key;
+
+	hash_index(
+		const hash_index& src); // undefined
+
+	hash_index& operator =(
+		const hash_index& src); // undefined
+
+	// bit i set for every control byte i equal to the byte
+	static unsigned match(
+		const control c,
+		const uint8_t byte)
+	{
+		const control eq = c == byte;
+
+#if __SSE2__
+		return unsigned(__builtin_ia32_pmovmskb128(char_control(eq)));
+#else
+		// gather the top bits of the bytes of either half by a multiply
+		uint64_t word[2];
+		memcpy(word, &eq, sizeof(word));
+
+		const uint64_t top = 0x8080808080808080ULL;
+		const uint64_t gather = 0x0002040810204081ULL;
+
+		return unsigned((word[0] & top) * gather >> 56) | unsigned((word[1] & top) * gather >> 56) << 8;
+#endif
+	}
+
+	size_t group_of(
+		const uint64_t h) const
+	{
+		return size_t(h >> 7) & num_group - 1;
+	}
+
+	static uint8_t tag_of(
+		const uint64_t h)
+	{
+		return uint8_t(h & 0x7f);
+	}
+
+public:
+	static const size_t npos = size_t(-1);
+
+	hash_index()
+	: num_group(0)
+	, num_key(0)
+	{
+	}
+
+	// build from an array of keys in any order, the position of a key being its index in the array, or that of its
+	// first occurrence; return 0 on failure, leaving the table intact
+	size_t build(
+		const KEY_T* const src,
+		const size_t len_src)
+	{
+		if (0 == len_src || uint32_t(-1) <= len_src)
+			return 0;
+
+		size_t new_num_group = 1;
+
+		while (new_num_group * group_size * 7 < len_src * 8)
+			new_num_group *= 2;
+
+		aligned_ptr< control, CACHELINE_SIZE > new_ctrl(new_num_group);
+		aligned_ptr< entry, CACHELINE_SIZE > new_slot(new_num_group * group_size);
+
+		if (new_ctrl.is_null() || new_slot.is_null())
+			return 0;
+
+		memset(static_cast< control* >(new_ctrl), empty, new_num_group * sizeof(control));
+		ctrl.move(new_ctrl);
+		slot.move(new_slot);
+		num_group = new_num_group;
+		num_key = 0;
+
+		for (size_t i = 0; i < len_src; ++i) {
+			if (npos != find(src[i]))
+				continue;
+
+			const uint64_t h = key_hash(src[i]);
+			size_t g = group_of(h);
+
+			for (size_t step = 1; ; g = g + step++ & num_group - 1) {
+				const unsigned free = match(ctrl[g], empty);
+
+				if (free) {
+					const size_t s = __builtin_ctz(free);
+					uint8_t byte[group_size];
+
+					memcpy(byte, &ctrl[g], sizeof(byte));
+					byte[s] = tag_of(h);
+					memcpy(&ctrl[g], byte, sizeof(byte));
+
+					slot[g * group_size + s].key = src[i];
+					slot[g * group_size + s].position = uint32_t(i);
+					break;
+				}
+			}
+
+			++num_key;
+		}
+
+		return 1;
+	}
+
+	// number of distinct keys in the table
+	size_t size() const
+	{
+		return num_key;
+	}
+
+	// number of bytes taken by the table
+	size_t storage_bytes() const
+	{
+		return num_group * (sizeof(control) + group_size * sizeof(entry));
+	}
+
+	// position of the key, or npos if absent
+	size_t find(
+		const KEY_T key) const
+	{
+		if (0 == num_group)
+			return npos;
+
+		const uint64_t h = key_hash(key);
+		const uint8_t tag = tag_of(h);
+		size_t g = group_of(h);
+
+		for (size_t step = 1; ; g = g + step++ & num_group - 1) {
+			const control c = ctrl[g];
+			const entry* const e = slot + g * group_size;
+
+			for (unsigned m = match(c, tag); m; m &= m - 1) {
+				const size_t s = __builtin_ctz(m);
+
+				if (e[s].key == key)
+					return e[s].position;
+			}
+
+			if (match(c, empty))
+				return npos;
+		}
+	}
+};
+
+} // namespace search
+
+#endif // hash_H__
@@ -0,0 +1,91 @@
+#ifndef histogram_H__
+#define histogram_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Log-linear histogram of latencies in nanoseconds: values below 8 get a bucket each, larger values 8 buckets per
+// power of two, for a relative error of at most 1/8 at constant cost per sample.
+class latency_histogram
+{
+	static const size_t sub_bits = 3;
+	static const size_t num_bucket = 62 << sub_bits;
+
+	uint64_t bucket[num_bucket];
+	uint64_t count;
+
+	static size_t bucket_of(
+		const uint64_t ns)
+	{
+		if (ns < 1 << sub_bits)
+			return size_t(ns);
+
+		const size_t msb = 63 - __builtin_clzll(ns);
+		return (msb - sub_bits + 1 << sub_bits) + size_t(ns >> msb - sub_bits & (1 << sub_bits) - 1);
+	}
+
+	// lowest value of a bucket
+	static uint64_t bucket_value(
+		const size_t i)
+	{
+		if (i < 1 << sub_bits)
+			return i;
+
+		const size_t msb = (i >> sub_bits) + sub_bits - 1;
+		return uint64_t((1 << sub_bits) + (i & (1 << sub_bits) - 1)) << msb - sub_bits;
+	}
+
+public:
+	latency_histogram()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		for (size_t i = 0; i < num_bucket; ++i)
+			bucket[i] = 0;
+
+		count = 0;
+	}
+
+	void add(
+		const uint64_t ns)
+	{
+		++bucket[bucket_of(ns)];
+		++count;
+	}
+
+	void merge(
+		const latency_histogram& src)
+	{
+		for (size_t i = 0; i < num_bucket; ++i)
+			bucket[i] += src.bucket[i];
+
+		count += src.count;
+	}
+
+	uint64_t total() const
+	{
+		return count;
+	}
+
+	// lowest value of the bucket holding the specified fraction of samples, e.g. .99 for p99
+	uint64_t percentile(
+		const double fraction) const
+	{
+		const uint64_t rank = uint64_t(fraction * count);
+		uint64_t sum = 0;
+
+		for (size_t i = 0; i < num_bucket; ++i) {
+			sum += bucket[i];
+
+			if (sum > rank)
+				return bucket_value(i);
+		}
+
+		return count ? bucket_value(num_bucket - 1) : 0;
+	}
+};
+
+#endif // histogram_H__
@@ -0,0 +1,261 @@
+#ifndef lazy_H__
+#define lazy_H__
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "bsearch.hpp"
+
+namespace search {
+
+// A VEB forest over a sorted array, laid out as prepare_for_veb_search does, but built on demand: the trees of the
+// top levels are built up front, and every tree below them from the sorted array the first time a search reaches
+// it, so that the time to the first search grows with the square root of the key count rather than with the key
+// count, and trees no search reaches never take memory. The forest and the states of its lazy trees live in
+// anonymous mappings, which the kernel zero-fills a page at a time on first touch. Each lazy tree has a state
+// byte: the first search to reach a tree claims it, builds it and publishes it; searches reaching a tree another
+// search is building read its keys from the sorted array meanwhile, so that no search ever waits, and searches of
+// any number of threads may run concurrently. The sorted array must outlive the index. Searches are exact-match,
+// returning the sorted rank of the first occurrence of the key, as search::index::find does.
+template < typename KEY_T, size_t LOG2_SUBSIZE >
+class lazy_veb_index
+{
+	enum tree_state {
+		state_absent,
+		state_building,
+		state_ready
+	};
+
+	const KEY_T* src;
+	size_t num_key;
+	size_t log2_size;
+	size_t log2_top;   // depth of the top tree
+	size_t eager_depth; // depth of the first lazy tree
+	size_t num_eager;  // number of trees above eager_depth, all built by build()
+	size_t num_tree;
+
+	KEY_T* storage;
+	uint8_t* state; // per lazy tree
+	size_t storage_bytes;
+	size_t state_bytes;
+
+	lazy_veb_index(
+		const lazy_veb_index& src); // undefined
+
+	lazy_veb_index& operator =(
+		const lazy_veb_index& src); // undefined
+
+	// item at the position of the sorted space, the last key standing in for the padding past it
+	KEY_T source_key(
+		const size_t pos) const
+	{
+		return src[pos < num_key ? pos : num_key - 1];
+	}
+
+	// sorted position of slot j of level i of tree t of the band at the depth
+	size_t linear_pos(
+		const size_t depth,
+		const size_t t,
+		const size_t i,
+		const size_t j) const
+	{
+		const size_t log2_stride = log2_size - depth;
+
+		return (t << log2_stride) + ((size_t(1) << log2_stride >> i + 1) * (j * 2 + 1)) - 1;
+	}
+
+	void build_tree(
+		const size_t tree,
+		const size_t depth,
+		const size_t t,
+		const size_t log2_tree) const
+	{
+		KEY_T* const k = storage + (tree << LOG2_SUBSIZE);
+
+		for (size_t i = 0; i < log2_tree; ++i)
+			for (size_t j = 0; j < size_t(1) << i; ++j)
+				k[(size_t(1) << i) - 1 + j] = source_key(linear_pos(depth, t, i, j));
+	}
+
+	// keys of the tree, built on first access, or null if another search is building it
+	const KEY_T* tree_keys(
+		const size_t tree,
+		const size_t depth,
+		const size_t t,
+		const size_t log2_tree) const
+	{
+		const KEY_T* const k = storage + (tree << LOG2_SUBSIZE);
+
+		if (tree < num_eager)
+			return k;
+
+		uint8_t* const s = state + tree - num_eager;
+		uint8_t st = __atomic_load_n(s, __ATOMIC_ACQUIRE);
+
+		if (state_ready == st)
+			return k;
+
+		if (state_absent == st && __atomic_compare_exchange_n(s, &st, uint8_t(state_building), false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			build_tree(tree, depth, t, log2_tree);
+			__atomic_store_n(s, uint8_t(state_ready), __ATOMIC_RELEASE);
+			return k;
+		}
+
+		return 0;
+	}
+
+	static void* map_zeroed(
+		const size_t bytes)
+	{
+		void* const p = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return MAP_FAILED == p ? 0 : p;
+	}
+
+	void unmap()
+	{
+		if (storage)
+			munmap(storage, storage_bytes);
+
+		if (state)
+			munmap(state, state_bytes);
+
+		storage = 0;
+		state = 0;
+		num_key = 0;
+	}
+
+public:
+	typedef KEY_T key_type;
+
+	static const size_t npos = size_t(-1);
+
+	lazy_veb_index()
+	: src(0)
+	, num_key(0)
+	, log2_size(0)
+	, log2_top(0)
+	, eager_depth(0)
+	, num_eager(0)
+	, num_tree(0)
+	, storage(0)
+	, state(0)
+	, storage_bytes(0)
+	, state_bytes(0)
+	{
+	}
+
+	~lazy_veb_index()
+	{
+		unmap();
+	}
+
+	// build the top trees over an array of keys sorted in ascending order, down to the first depth of trees at or
+	// past eager_levels, by default half the depth of the forest; return 0 on failure
+	size_t build(
+		const KEY_T* const new_src,
+		const size_t len_src,
+		const size_t eager_levels = size_t(-1))
+	{
+		unmap();
+
+		if (0 == len_src)
+			return 0;
+
+		const size_t space_size = tree_space_size(len_src);
+
+		log2_size = log2_from_pot(space_size);
+		log2_top = veb_top_level(log2_size, LOG2_SUBSIZE);
+		num_tree = veb_total_size(space_size, size_t(1) << LOG2_SUBSIZE) >> LOG2_SUBSIZE;
+
+		const size_t eager = size_t(-1) == eager_levels ? log2_size / 2 : eager_levels;
+
+		eager_depth = 0;
+		num_eager = 0;
+
+		while (eager_depth < log2_size && eager_depth < eager) {
+			num_eager += size_t(1) << eager_depth;
+			eager_depth += eager_depth ? LOG2_SUBSIZE : log2_top;
+		}
+
+		storage_bytes = num_tree * sizeof(KEY_T) << LOG2_SUBSIZE;
+		state_bytes = num_tree - num_eager ? num_tree - num_eager : 1;
+		storage = reinterpret_cast< KEY_T* >(map_zeroed(storage_bytes));
+		state = reinterpret_cast< uint8_t* >(map_zeroed(state_bytes));
+
+		if (0 == storage || 0 == state) {
+			unmap();
+			return 0;
+		}
+
+		src = new_src;
+		num_key = len_src;
+
+		for (size_t depth = 0, tree = 0; depth < eager_depth; ) {
+			const size_t log2_tree = depth ? LOG2_SUBSIZE : log2_top;
+
+			for (size_t t = 0; t < size_t(1) << depth; ++t, ++tree)
+				build_tree(tree, depth, t, log2_tree);
+
+			depth += log2_tree;
+		}
+
+		return 1;
+	}
+
+	// number of keys in the index
+	size_t size() const
+	{
+		return num_key;
+	}
+
+	// number of trees of the forest, and of those built so far; the latter counts the states of the lazy trees
+	size_t trees() const
+	{
+		return num_tree;
+	}
+
+	size_t built_trees() const
+	{
+		size_t count = num_eager;
+
+		for (size_t i = 0; i < num_tree - num_eager; ++i)
+			count += state_ready == __atomic_load_n(state + i, __ATOMIC_RELAXED);
+
+		return count;
+	}
+
+	// sorted position of the first occurrence of the key, or npos if absent; the descent runs to the bottom of the
+	// forest, where the index of the leaf reached is the lower bound of the key, whose item is the last item of the
+	// path not less than the key
+	size_t find(
+		const KEY_T key) const
+	{
+		size_t first = 0; // index of the first tree of the band
+		size_t t = 0;     // index of the tree within the band
+		bool hit = false; // whether the last item not less than the key equals it
+
+		for (size_t depth = 0, log2_tree = log2_top; depth < log2_size; ) {
+			const KEY_T* const k = tree_keys(first + t, depth, t, log2_tree);
+			size_t j = 0;
+
+			for (size_t i = 0; i < log2_tree; ++i) {
+				const KEY_T ki = k ? k[(size_t(1) << i) - 1 + j] : source_key(linear_pos(depth, t, i, j));
+
+				hit = ki < key ? hit : key == ki;
+				j = j * 2 + (ki < key);
+			}
+
+			first += size_t(1) << depth;
+			t = (t << log2_tree) + j;
+			depth += log2_tree;
+			log2_tree = LOG2_SUBSIZE;
+		}
+
+		// the padding repeats the last key, so the lower bound of a key present is a position of the sorted array
+		return hit ? t : npos;
+	}
+};
+
+} // namespace search
+
+#endif // lazy_H__
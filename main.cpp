@@ -3,11 +3,21 @@
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <math.h>
+#include <algorithm>
+#include <map>
 
 #include "timer.h"
 #include "aligned_ptr.hpp"
 #include "compile_assert.hpp"
 #include "rand.hpp"
+#include "histogram.hpp"
+#include "calibrate.hpp"
 
 #define ROUTINE_ALIGNMENT CACHELINE_SIZE
 
@@ -26,10 +36,82 @@ typedef float searchitem_t;
 
 static const char arg_space_size[] = "space_size";
 static const char arg_alt[] = "alt";
+static const char arg_mode[] = "mode";
+static const char arg_threads[] = "threads";
+static const char arg_numa[] = "numa";
+static const char arg_lookahead[] = "lookahead";
+static const char arg_updates[] = "updates";
+static const char arg_delta[] = "delta";
+static const char arg_file[] = "file";
+static const char arg_depth[] = "depth";
+static const char arg_dups[] = "dups";
+static const char arg_tables[] = "tables";
+static const char arg_bits[] = "bits";
+static const char arg_input[] = "input";
+static const char arg_output[] = "output";
+static const char arg_trace[] = "trace";
+static const char arg_rate[] = "rate";
+static const char arg_calibrate[] = "calibrate";
+static const char arg_thrash[] = "thrash";
+
+enum Mode {
+	mode_search, // free-standing search routines selected by alt (default)
+	mode_index,  // search::index of the layout selected by alt
+	mode_bulk,   // multi-threaded bulk search in a search::index of the layout selected by alt
+	mode_shard,  // thread-per-core sharded search vs multi-threaded bulk search in a shared search::index
+	mode_helper, // search routine selected by alt, with vs without an SMT helper thread prefetching ahead
+	mode_update, // lookups in a search::updatable_index of the layout selected by alt, with vs without updates
+	mode_merge,  // merge of a sorted batch into a search::index of the layout selected by alt vs a rebuild
+	mode_file,   // cold lookups in a file-backed search::paged_index with fences in the layout selected by alt
+	mode_packed, // search::packed_index of 64-bit keys with fences in the layout selected by alt vs raw VEB search
+	mode_rank,   // search routine selected by alt returning layout positions vs sorted ranks
+	mode_dups,   // equal_range in a search::index of duplicate keys of the layout selected by alt vs find then scan
+	mode_range,  // in-order range scans by cursor in a search::index of the layout selected by alt vs a sorted array
+	mode_segmented, // lookups in small tables of a search::segmented_index of the layout selected by alt vs one allocation each
+	mode_radix,  // build of a search::index of the layout selected by alt from unsorted keys by radix sort vs sort then build
+	mode_filter, // exact-match search in a search::index of the layout selected by alt with vs without a Bloom filter
+	mode_cache,  // exact-match search of Zipf-distributed keys in a search::index of the layout selected by alt with vs without a hot-key cache
+	mode_stream, // exact-match search of binary keys streamed from input to output through a search::index of the layout selected by alt
+	mode_record, // capture of the sample as a trace of queries, with table ids and arrival times
+	mode_replay, // replay of a trace of queries in a search::index or search::segmented_index of the layout selected by alt
+	mode_cold,   // search in a search::index of the layout selected by alt, warm vs under cache pressure vs unfaulted vs locked
+	mode_weighted, // exact-match search of Zipf-distributed keys in a search::weighted_tree built from a query profile vs a search::index of the layout selected by alt
+	mode_lazy,   // startup and search of a search::lazy_veb_index built on demand vs a search::index of the layout selected by alt built in full
+	mode_multi,  // exact-match search of every key in 2 through 16 VEB indexes of mixed sizes, one after another vs interleaved
+
+	mode_count
+};
+
+static const char* const mode_name[mode_count] = {
+	"search",
+	"index",
+	"bulk",
+	"shard",
+	"helper",
+	"update",
+	"merge",
+	"file",
+	"packed",
+	"rank",
+	"dups",
+	"range",
+	"segmented",
+	"radix",
+	"filter",
+	"cache",
+	"stream",
+	"record",
+	"replay",
+	"cold",
+	"weighted",
+	"lazy",
+	"multi"
+};
 
 static const size_t log2_lead_in = 4; // number of top-level bsearch iterations bypassed during binned bsearch
 static const size_t lead_in = 1 << log2_lead_in;
 static const size_t log2_subsize = 4; // depth of the individual tree in the Van Emde Boas forest
+static const size_t prefix_levels = 12; // number of top tree levels mirrored by 16-bit key prefixes in the prefix layouts
 static const size_t alignment = 1 << 6; // search space address alignment
 
 size_t found[1];
@@ -148,6 +230,20 @@ static size_t log2_ceil(
 }
 
 #include "bsearch.hpp"
+#include "bulk.hpp"
+#include "shard.hpp"
+#include "update.hpp"
+#include "paged.hpp"
+#include "packed.hpp"
+#include "segmented.hpp"
+#include "radix.hpp"
+#include "filter.hpp"
+#include "cache.hpp"
+#include "hash.hpp"
+#include "stream.hpp"
+#include "trace.hpp"
+#include "weighted.hpp"
+#include "lazy.hpp"
 
 static size_t lsearch_standard(
 	const searchitem_t* const,
@@ -240,6 +336,118 @@ static size_t bsearch_veb_iter(
 	return search::bsearch_veb_iter< log2_subsize >(space, size, key);
 }
 
+static size_t bsearch_binned_rank(
+	const searchitem_t* const,
+	const size_t,
+	const searchitem_t) __attribute__ ((aligned(ROUTINE_ALIGNMENT)));
+
+static size_t bsearch_binned_rank(
+	const searchitem_t* const space,
+	const size_t size,
+	const searchitem_t key)
+{
+	return search::bsearch_binned_rank< lead_in >(space, size, key);
+}
+
+static size_t bsearch_breadth_rank(
+	const searchitem_t* const,
+	const size_t,
+	const searchitem_t) __attribute__ ((aligned(ROUTINE_ALIGNMENT)));
+
+static size_t bsearch_breadth_rank(
+	const searchitem_t* const space,
+	const size_t size,
+	const searchitem_t key)
+{
+	return search::bsearch_breadth_rank(space, size, key);
+}
+
+static size_t bsearch_veb_iter_rank(
+	const searchitem_t* const,
+	const size_t,
+	const searchitem_t) __attribute__ ((aligned(ROUTINE_ALIGNMENT)));
+
+static size_t bsearch_veb_iter_rank(
+	const searchitem_t* const space,
+	const size_t size,
+	const searchitem_t key)
+{
+	return search::bsearch_veb_iter_rank< log2_subsize >(space, size, key);
+}
+
+// reference structures of alts 10 and 11, built from the search space by the verify routines of the alts; their
+// search routines take the space for uniformity only
+static std::map< searchitem_t, size_t > reference_map;
+static search::hash_index< searchitem_t > reference_hash;
+
+static size_t bsearch_stl(
+	const searchitem_t* const,
+	const size_t,
+	const searchitem_t) __attribute__ ((aligned(ROUTINE_ALIGNMENT)));
+
+static size_t bsearch_stl(
+	const searchitem_t* const space,
+	const size_t size,
+	const searchitem_t key)
+{
+	const searchitem_t* const it = std::lower_bound(space, space + size, key);
+	return space + size != it && *it == key ? size_t(it - space) : size_t(-1);
+}
+
+static size_t search_map(
+	const searchitem_t* const,
+	const size_t,
+	const searchitem_t) __attribute__ ((aligned(ROUTINE_ALIGNMENT)));
+
+static size_t search_map(
+	const searchitem_t* const,
+	const size_t,
+	const searchitem_t key)
+{
+	const std::map< searchitem_t, size_t >::const_iterator it = reference_map.find(key);
+	return reference_map.end() != it ? it->second : size_t(-1);
+}
+
+static size_t search_hash(
+	const searchitem_t* const,
+	const size_t,
+	const searchitem_t) __attribute__ ((aligned(ROUTINE_ALIGNMENT)));
+
+static size_t search_hash(
+	const searchitem_t* const,
+	const size_t,
+	const searchitem_t key)
+{
+	return reference_hash.find(key);
+}
+
+// maps of the layout positions returned by the search routines to sorted ranks, for mode rank
+
+static size_t rank_from_binned(
+	const size_t,
+	const size_t pos)
+{
+	return size_t(-1) == pos ? pos : pos - lead_in;
+}
+
+static size_t rank_from_breadth(
+	const size_t space_size,
+	const size_t pos)
+{
+	if (size_t(-1) == pos)
+		return pos;
+
+	const size_t level = sizeof(unsigned long) * 8 - 1 - __builtin_clzl((unsigned long)(pos + 1));
+	return search::linear_from_breadth(space_size, pos, level);
+}
+
+static size_t rank_from_veb(
+	const size_t space_size,
+	const size_t pos)
+{
+	return size_t(-1) == pos ? pos : search::linear_from_veb(space_size, log2_subsize, pos);
+}
+
 static size_t verify_lsearch_standard(
 	const size_t space_size,
 	searchitem_t* space)
@@ -398,6 +606,14 @@ static const T& min(
 	return a < b ? a : b;
 }
 
+template < typename T >
+static const T& max(
+	const T& a,
+	const T& b)
+{
+	return a > b ? a : b;
+}
+
 static size_t verify_bsearch_breadth(
 	const size_t raw_space_size,
 	searchitem_t* space)
@@ -549,153 +765,3230 @@ static size_t verify_bsearch_veb_iter(
 	return size_t(error);
 }
 
-template < typename SEARCHITEM_T, typename KEY_T >
-struct Search
+// common part of the verify routines of the reference alts: the space is sorted, the structure of the alt, if any,
+// built from it by the caller
+static size_t verify_reference(
+	size_t (* const search)(const searchitem_t* const, const size_t, const searchitem_t),
+	const char* const name,
+	const size_t space_size,
+	const searchitem_t* const space)
 {
-	typedef size_t (* search)(const SEARCHITEM_T* const, const size_t, const KEY_T);
-	typedef size_t (* verify)(const size_t, SEARCHITEM_T*);
-};
+	fprintf(stderr, "verifying %s consistency for size " FMT_ULONG ".. ", name, space_size);
 
+	bool error = false;
 
-static int parse_cli(
-	int argc,
-	char** argv,
-	size_t& rep,
-	size_t& space_size,
-	Search< searchitem_t, searchitem_t >::search& search,
-	Search< searchitem_t, searchitem_t >::verify& verify)
+	for (size_t i = 0; i < space_size; ++i) {
+		const size_t f = search(space, space_size, searchitem_t(i));
+
+		if (size_t(-1) == f || space[f] != searchitem_t(i)) {
+			fprintf(stderr, "\nFAILURE at " FMT_ULONG ", size " FMT_ULONG, i, space_size);
+			error = true;
+		}
+	}
+
+	if (size_t(-1) != search(space, space_size, searchitem_t(space_size)) ||
+		size_t(-1) != search(space, space_size, searchitem_t(-.5))) {
+		fprintf(stderr, "\nFAILURE at absent keys, size " FMT_ULONG, space_size);
+		error = true;
+	}
+
+	if (!error)
+		fprintf(stderr, "done\n");
+	else
+		putc('\n', stderr);
+
+	return size_t(error);
+}
+
+static size_t verify_bsearch_stl(
+	const size_t space_size,
+	searchitem_t* space)
 {
-	bool rep_done = false;
+	aligned_ptr< searchitem_t, alignment > local_space;
 
-	for (int i = 1; i < argc; ++i) {
-		// use a double for all numeric arguments, so the user can specify big numbers in scientific notation
-		double input;
+	if (0 == space) {
+		local_space.malloc(space_size);
+		space = local_space;
+	}
 
-		if (0 == strcmp(argv[i], arg_space_size)) {
-			const unsigned max_size = 1U << 24;
-			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 0 < input) {
-				if (input > max_size) {
-					fprintf(stderr, "error: %s should not exceed %u\n",
-						arg_space_size, max_size);
-					return -1;
-				}
-				if (0 != (unsigned(input) & unsigned(input) - 1)) {
-					fprintf(stderr, "error: %s should be a power of two\n",
-						arg_space_size);
-					return -1;
-				}
+	for (size_t i = 0; i < space_size; ++i)
+		space[i] = searchitem_t(i);
 
-				space_size = size_t(input);
-				continue;
-			}
-		}
+	return verify_reference(bsearch_stl, "bsearch_stl", space_size, space);
+}
 
-		if (0 == strcmp(argv[i], arg_alt)) {
-			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 0 <= input && 7 >= input) {
-				const size_t alt = size_t(input);
-				switch (alt) {
-				case 1:
-					search = bsearch_binned;
-					verify = verify_bsearch_binned;
-					break;
-				case 2:
-					search = bsearch_breadth;
-					verify = verify_bsearch_breadth;
-					break;
-				case 3:
-					search = bsearch_veb;
-					verify = verify_bsearch_veb;
-					break;
-				case 4:
-					search = bsearch_veb_iter;
-					verify = verify_bsearch_veb_iter;
-					break;
-				case 5:
-					search = lsearch_standard;
-					verify = verify_lsearch_standard;
-					break;
-				case 6:
-					search = lsearch_binned;
-					verify = verify_lsearch_binned;
-					break;
-				}
-				continue;
-			}
-			rep_done = true;
-		}
+static size_t verify_search_map(
+	const size_t space_size,
+	searchitem_t* space)
+{
+	aligned_ptr< searchitem_t, alignment > local_space;
 
-		if (!rep_done && 1 == sscanf(argv[i], "%lf", &input) && 0 < input) {
-			rep = size_t(input);
-			rep_done = true;
-			continue;
-		}
+	if (0 == space) {
+		local_space.malloc(space_size);
+		space = local_space;
+	}
 
-		fprintf(stderr, "usage: %s [%s <unsigned>] [%s <unsigned>] [<sample_size>]\n"
-			"\talt 0: standard binary search (default)\n"
-			"\talt 1: binned binary search\n"
-			"\talt 2: breadth-first layout binary search\n"
-			"\talt 3: Van Emde Boas (VEB) layout binary search, recursive version\n"
-			"\talt 4: VEB layout binary search, iterative version\n"
-			"\talt 5: standard linear search\n"
-			"\talt 6: binned linear search\n",
-			argv[0], arg_space_size, arg_alt);
+	reference_map.clear();
 
-		return -1;
+	for (size_t i = 0; i < space_size; ++i) {
+		space[i] = searchitem_t(i);
+		reference_map.insert(reference_map.end(), std::make_pair(space[i], i));
 	}
 
-	return 0;
+	return verify_reference(search_map, "search_map", space_size, space);
 }
 
-
-int main(
-	int argc,
-	char** argv)
+static size_t verify_search_hash(
+	const size_t space_size,
+	searchitem_t* space)
 {
-	size_t rep = 1e7;
-	size_t space_size = 2e3;
-
-	Search< searchitem_t, searchitem_t >::search search = bsearch_standard;
-	Search< searchitem_t, searchitem_t >::verify verify = verify_bsearch_standard;
+	aligned_ptr< searchitem_t, alignment > local_space;
 
-	const int cli_res = parse_cli(
-		argc, argv,
-		rep, space_size, search, verify);
+	if (0 == space) {
+		local_space.malloc(space_size);
+		space = local_space;
+	}
 
-	if (0 != cli_res)
-		return cli_res;
+	for (size_t i = 0; i < space_size; ++i)
+		space[i] = searchitem_t(i);
 
-	printf("generating search space..\n");
+	if (!reference_hash.build(space, space_size)) {
+		fprintf(stderr, "verifying search_hash consistency for size " FMT_ULONG ".. FAILURE to build\n", space_size);
+		return 1;
+	}
 
-	const uint64_t s0 = timer_ns();
+	return verify_reference(search_hash, "search_hash", space_size, space);
+}
 
-	// generate 'search sample' - a random array of type searchitem_t and size rep
-	const compile_assert< 0 == (rnd::rand_max & rnd::rand_max + 1LL) > assert_rand_max_is_pot_minus_one;
-	const aligned_ptr< searchitem_t, alignment > sample(rep);
+template < typename LAYOUT_T >
+static size_t verify_index(
+	const search::index< searchitem_t, LAYOUT_T >& index,
+	const char* const name)
+{
+	// index is expected to hold the keys 0 through size - 1
+	const size_t size = index.size();
 
-	const unsigned log2_rand = bitcount(rnd::rand_max);
-	assert(0 == (space_size & space_size - 1));
-	const unsigned log2_space = log2_from_pot(space_size);
-	assert(log2_rand >= log2_space);
-	unsigned seed = 42;
+	fprintf(stderr, "verifying index_%s consistency for size " FMT_ULONG ".. ", name, size);
 
-	for (size_t i = 0; i < rep; ++i)
-		sample[i] = searchitem_t(rnd::rand_r(&seed) >> log2_rand - log2_space);
+	bool error = false;
 
-	// generate 'search space' - a sorted array from 0 to space_size - 1
-	aligned_ptr< searchitem_t, alignment > space;
+	for (size_t i = 0; i < size; ++i) {
+		const size_t f = index.find(searchitem_t(i));
+		const size_t lb = index.lower_bound(searchitem_t(i));
 
-	if (search == bsearch_binned ||
-		search == lsearch_binned) {
+		// midpoints past the precision of the key type round to a neighbouring key
+		const searchitem_t mid = searchitem_t(i) + searchitem_t(.5f);
+		const bool mid_exact = mid != searchitem_t(i) && mid != searchitem_t(i + 1);
+		const size_t nf = mid_exact ? index.find(mid) : index.npos;
+		const size_t nlb = mid_exact ? index.lower_bound(mid) : i + 1;
 
-		if (64 > space_size) {
-			fprintf(stderr, "error: binned %s requires a minimum space size of 64\n", search == bsearch_binned ? "bsearch" : "lsearch");
-			return -1;
+		if (f != i || lb != i || nf != index.npos || nlb != i + 1) {
+			fprintf(stderr, "\nFAILURE at " FMT_ULONG ", size " FMT_ULONG, i, size);
+			error = true;
 		}
+	}
 
-		space_size -= 1; // drop one to even ground with BFS and VEB
-		space.malloc(space_size + lead_in);
-
-		printf("verifying binned %s consistency for " FMT_ULONG " bins..\n", search == bsearch_binned ? "bsearch" : "lsearch", lead_in);
+	if (index.find(searchitem_t(-1)) != index.npos || index.lower_bound(searchitem_t(-1)) != 0 ||
+		index.find(searchitem_t(size)) != index.npos || index.lower_bound(searchitem_t(size)) != size) {
+		fprintf(stderr, "\nFAILURE out of range, size " FMT_ULONG, size);
+		error = true;
+	}
+
+	if (!error)
+		fprintf(stderr, "done\n");
+	else
+		putc('\n', stderr);
+
+	return size_t(error);
+}
+
+static const size_t batch_size = 256; // number of keys per call to a batch search routine
+
+enum Numa {
+	numa_off,         // unpinned threads, space first-touched by the main thread (default)
+	numa_first_touch, // threads pinned across nodes, space first-touched by the main thread
+	numa_interleave,  // threads pinned across nodes, space pages interleaved across nodes
+	numa_replicate,   // threads pinned across nodes, each searching a replica first-touched on its node
+
+	numa_count
+};
+
+static const char* const numa_name[numa_count] = {
+	"off",
+	"first_touch",
+	"interleave",
+	"replicate"
+};
+
+// parameters of the benchmark modes other than the default one
+struct Options
+{
+	size_t threads; // maximum number of threads of the multi-threaded modes
+	Numa numa;      // placement of the search space of the multi-threaded modes
+	size_t lookahead; // maximum number of keys the helper thread runs ahead of the main thread
+	size_t updates; // number of updates per second streamed in mode update, 0 for as many as possible
+	size_t delta;   // number of delta entries triggering a rebuild in mode update
+	const char* file; // path of the file of mode file
+	size_t depth;     // number of threads issuing page reads in mode file
+	size_t dups;      // number of occurrences of each key in mode dups
+	size_t tables;    // number of tables in modes segmented and record
+	size_t bits;      // number of Bloom filter bits per key in mode filter
+	const char* input;  // path of the keys of mode stream, - for stdin
+	const char* output; // path of the positions of mode stream, - for stdout
+	const char* trace;  // path of the trace of modes record and replay
+	size_t rate;        // mean number of queries per second of the arrival times of mode record, 0 for none
+	size_t calibrate;   // whether to measure the memory profile of the host ahead of the run
+	size_t thrash;      // KB streamed over by the cache-thrashing thread of mode cold, 0 for twice the last-level cache
+};
+
+static memory_profile memory; // of the host, if calibrated
+
+
+static void report_searches(
+	const uint64_t dt,
+	const size_t rep,
+	const size_t size)
+{
+	if (dt) {
+		const double sec = double(dt) * 1e-9;
+		printf("elapsed time: %f (" FMT_ULONG " repetitions over a space of " FMT_ULONG ")\n", sec, rep, size);
+		printf("average searches/s: %f\n", rep / sec);
+
+		// relative to the measured memory profile: a search of a tree of size items takes as many dependent
+		// loads as the tree has levels, the deeper ones missing the caches
+		if (memory.calibrated() && rep && size) {
+			const double ns = double(dt) / rep;
+			const double bound = memory.tree_latency(size, sizeof(searchitem_t));
+			const size_t depth = sizeof(unsigned long long) * 8 - __builtin_clzll((unsigned long long) size);
+
+			printf("per search: %.1f ns, %.2f memory latencies; latency-bound rate for " FMT_ULONG " levels: %f searches/s, %.1f%% of it\n",
+				ns, ns / memory.memory_latency(), depth, 1e9 / bound, 100 * bound / ns);
+		}
+	}
+}
+
+template < typename INDEX_T >
+static int bench_index(
+	const INDEX_T& index,
+	const searchitem_t* const sample,
+	const size_t rep)
+{
+	printf("searching..\n");
+
+	const uint64_t t0 = timer_ns();
+
+	for (size_t i = 0; i < rep; ++i)
+		found[i * obfuscator] = index.find(sample[i]);
+
+	report_searches(timer_ns() - t0, rep, index.size());
+
+	printf("batch searching..\n");
+
+	size_t result[batch_size];
+	const uint64_t t1 = timer_ns();
+
+	for (size_t i = 0; i < rep; i += batch_size) {
+		const size_t count = min(batch_size, rep - i);
+
+		index.find(sample + i, count, result);
+		found[i * obfuscator] = result[count - 1];
+	}
+
+	report_searches(timer_ns() - t1, rep, index.size());
+
+	return 0;
+}
+
+template < typename INDEX_T >
+struct replica_build
+{
+	INDEX_T* index;
+	const typename INDEX_T::key_type* src;
+	size_t size;
+	size_t success;
+
+	static void run(
+		void* const arg)
+	{
+		replica_build& build = *reinterpret_cast< replica_build* >(arg);
+		build.success = build.index->build(build.src, build.size);
+	}
+};
+
+template < typename INDEX_T >
+static int bench_bulk(
+	const INDEX_T& index,
+	const typename INDEX_T::key_type* const src,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options)
+{
+	const topology topo;
+
+	printf("numa placement %s over " FMT_ULONG " nodes, " FMT_ULONG " cpus\n", numa_name[options.numa], topo.nodes(), topo.cpus());
+
+	// replicas are built by threads pinned to their nodes, so that each replica is first-touched on its node
+	INDEX_T replica[topology::max_node];
+
+	if (numa_replicate == options.numa)
+		for (size_t i = 0; i < topo.nodes(); ++i) {
+			replica_build< INDEX_T > build = { replica + i, src, index.size(), 0 };
+
+			if (!run_pinned(topo.node_cpu(i, 0), replica_build< INDEX_T >::run, &build) || !build.success) {
+				fprintf(stderr, "error: failed to build replica on node " FMT_ULONG "\n", topo.node_id(i));
+				return -1;
+			}
+		}
+
+	if (numa_interleave == options.numa &&
+		!interleave_pages(index.data(), index.storage_size() * sizeof(*index.data()), topo)) {
+		fprintf(stderr, "error: failed to interleave the space across nodes\n");
+		return -1;
+	}
+
+	aligned_ptr< size_t, alignment > result(rep);
+	aligned_ptr< size_t, alignment > cpu(options.threads);
+	aligned_ptr< const INDEX_T*, alignment > worker_index(options.threads);
+
+	// double the thread count on each run, up to the maximum
+	for (size_t threads = 1; ; threads = min(threads * 2, options.threads)) {
+		for (size_t i = 0; i < threads; ++i) {
+			size_t node;
+			cpu[i] = topo.worker_cpu(i, node);
+			worker_index[i] = numa_replicate == options.numa ? replica + node : &index;
+		}
+
+		thread_pool pool;
+
+		if (!pool.init(threads, numa_off == options.numa ? 0 : static_cast< const size_t* >(cpu))) {
+			fprintf(stderr, "error: failed to start " FMT_ULONG " threads\n", threads);
+			return -1;
+		}
+
+		printf("bulk searching with " FMT_ULONG " threads..\n", threads);
+
+		const uint64_t t0 = timer_ns();
+
+		search::bulk_find(pool, static_cast< const INDEX_T* const* >(worker_index), sample, rep, result);
+
+		report_searches(timer_ns() - t0, rep, index.size());
+
+		for (size_t i = 0; i < rep; ++i)
+			if (result[i] != index.find(sample[i])) {
+				fprintf(stderr, "error: bulk search FAILURE at " FMT_ULONG "\n", i);
+				return -1;
+			}
+
+		if (threads == options.threads)
+			break;
+	}
+
+	return 0;
+}
+
+template < typename INDEX_T >
+static int bench_shard(
+	const INDEX_T& index,
+	const typename INDEX_T::key_type* const src,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options)
+{
+	const topology topo;
+	const size_t threads = options.threads;
+
+	// one thread per core, the same cores for both engines
+	aligned_ptr< size_t, alignment > cpu(threads);
+
+	for (size_t i = 0; i < threads; ++i) {
+		size_t node;
+		cpu[i] = topo.worker_cpu(i, node);
+	}
+
+	aligned_ptr< size_t, alignment > result(rep);
+
+	{
+		thread_pool pool;
+
+		if (!pool.init(threads, cpu)) {
+			fprintf(stderr, "error: failed to start " FMT_ULONG " threads\n", threads);
+			return -1;
+		}
+
+		printf("bulk searching a shared space of " FMT_ULONG " bytes with " FMT_ULONG " threads..\n",
+			index.storage_size() * sizeof(*index.data()), threads);
+
+		const uint64_t t0 = timer_ns();
+
+		search::bulk_find(pool, index, sample, rep, result);
+
+		report_searches(timer_ns() - t0, rep, index.size());
+	}
+
+	search::sharded_index< INDEX_T > sharded;
+
+	if (!sharded.build(src, index.size(), threads, cpu)) {
+		fprintf(stderr, "error: failed to build " FMT_ULONG " shards\n", threads);
+		return -1;
+	}
+
+	size_t max_shard_bytes = 0;
+
+	for (size_t i = 0; i < sharded.shard_count(); ++i)
+		max_shard_bytes = max(max_shard_bytes, sharded.shard_index(i).storage_size() * sizeof(*index.data()));
+
+	printf("sharded searching with " FMT_ULONG " shards of up to " FMT_ULONG " bytes..\n", sharded.shard_count(), max_shard_bytes);
+
+	const uint64_t t1 = timer_ns();
+
+	sharded.find(sample, rep, result);
+
+	report_searches(timer_ns() - t1, rep, index.size());
+
+	for (size_t i = 0; i < rep; ++i)
+		if (result[i] != index.find(sample[i])) {
+			fprintf(stderr, "error: sharded search FAILURE at " FMT_ULONG "\n", i);
+			return -1;
+		}
+
+	return 0;
+}
+
+static const size_t update_latency_period = 16; // number of lookups per latency sample in mode update
+
+template < typename LAYOUT_T >
+struct update_read_job
+{
+	typedef search::updatable_index< searchitem_t, LAYOUT_T > index_type;
+
+	index_type* index;
+	const searchitem_t* sample;
+	size_t count;
+	latency_histogram* histogram; // per worker
+
+	static void run(
+		void* const arg,
+		const size_t chunk,
+		const size_t worker)
+	{
+		const update_read_job& job = *reinterpret_cast< const update_read_job* >(arg);
+		const size_t begin = chunk * search::bulk_chunk_size;
+		const size_t end = min(begin + search::bulk_chunk_size, job.count);
+		size_t hits = 0;
+
+		for (size_t i = begin; i < end; ++i) {
+			if (0 == i % update_latency_period) {
+				const uint64_t t0 = timer_ns();
+				hits += job.index->contains(worker, job.sample[i]);
+				job.histogram[worker].add(timer_ns() - t0);
+			}
+			else
+				hits += job.index->contains(worker, job.sample[i]);
+		}
+
+		__atomic_store_n(&found[chunk * obfuscator], hits, __ATOMIC_RELAXED);
+	}
+};
+
+// Writer thread of mode update: it toggles the presence of random keys from the set of keys 0 through size - 1
+// and their midpoints, at a steady pace, until told to stop. Integral keys are present initially.
+template < typename LAYOUT_T >
+struct update_writer
+{
+	search::updatable_index< searchitem_t, LAYOUT_T >* index;
+	uint8_t* present; // presence of key i / 2 at i, 0 through 2 * size - 1
+	size_t size;
+	size_t rate;
+	size_t count; // number of updates applied
+	bool stop;
+
+	static void* entry(
+		void* arg)
+	{
+		update_writer& writer = *reinterpret_cast< update_writer* >(arg);
+		unsigned seed = 1;
+		const uint64_t t0 = timer_ns();
+
+		while (!__atomic_load_n(&writer.stop, __ATOMIC_RELAXED)) {
+			if (writer.rate) {
+				const uint64_t due = t0 + uint64_t(writer.count) * 1000000000ULL / writer.rate;
+				const uint64_t now = timer_ns();
+
+				if (now < due) {
+					const timespec ts = { time_t((due - now) / 1000000000ULL), long((due - now) % 1000000000ULL) };
+					nanosleep(&ts, 0);
+					continue;
+				}
+			}
+
+			const size_t i = rnd::rand_r(&seed) % (writer.size * 2);
+			const searchitem_t key = searchitem_t(i * .5f);
+
+			if (writer.present[i])
+				writer.index->erase(key);
+			else
+				writer.index->insert(key);
+
+			writer.present[i] ^= 1;
+			++writer.count;
+		}
+
+		return 0;
+	}
+};
+
+static void report_latency(
+	const latency_histogram& histogram)
+{
+	printf("latency ns p50: " FMT_ULONG ", p99: " FMT_ULONG ", p99.9: " FMT_ULONG " (" FMT_ULONG " samples)\n",
+		size_t(histogram.percentile(.5)), size_t(histogram.percentile(.99)), size_t(histogram.percentile(.999)),
+		size_t(histogram.total()));
+}
+
+template < typename LAYOUT_T >
+static int bench_update(
+	const searchitem_t* const src,
+	const size_t size,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options)
+{
+	typedef search::updatable_index< searchitem_t, LAYOUT_T > index_type;
+
+	// the keys toggled by the writer include midpoints, which must be exact in the key type
+	if (size_t(searchitem_t(size * 2 - 1)) != size * 2 - 1) {
+		fprintf(stderr, "error: %s %s requires a smaller %s\n", arg_mode, mode_name[mode_update], arg_space_size);
+		return -1;
+	}
+
+	const size_t threads = min(options.threads, size_t(index_type::max_reader));
+	index_type index(options.delta);
+
+	if (!index.build(src, size)) {
+		fprintf(stderr, "error: failed to build updatable index of size " FMT_ULONG "\n", size);
+		return -1;
+	}
+
+	thread_pool pool;
+
+	if (!pool.init(threads)) {
+		fprintf(stderr, "error: failed to start " FMT_ULONG " threads\n", threads);
+		return -1;
+	}
+
+	aligned_ptr< latency_histogram, alignment > histogram(threads);
+	update_read_job< LAYOUT_T > job = { &index, sample, rep, histogram };
+	const size_t num_chunk = (rep + search::bulk_chunk_size - 1) / search::bulk_chunk_size;
+
+	// without updates, then with updates streaming in
+	for (size_t pass = 0; pass < 2; ++pass) {
+		aligned_ptr< uint8_t, alignment > present(size * 2);
+
+		for (size_t i = 0; i < size * 2; ++i)
+			present[i] = uint8_t(0 == i % 2);
+
+		update_writer< LAYOUT_T > writer = { &index, present, size, options.updates, 0, false };
+		pthread_t thread;
+
+		for (size_t i = 0; i < threads; ++i)
+			histogram[i].reset();
+
+		if (pass) {
+			if (options.updates)
+				printf("looking up with " FMT_ULONG " threads, " FMT_ULONG " updates/s, rebuild every " FMT_ULONG " updates..\n",
+					threads, options.updates, options.delta);
+			else
+				printf("looking up with " FMT_ULONG " threads, unpaced updates, rebuild every " FMT_ULONG " updates..\n",
+					threads, options.delta);
+
+			if (pthread_create(&thread, 0, update_writer< LAYOUT_T >::entry, &writer)) {
+				fprintf(stderr, "error: failed to start writer thread\n");
+				return -1;
+			}
+		}
+		else
+			printf("looking up with " FMT_ULONG " threads, no updates..\n", threads);
+
+		const uint64_t t0 = timer_ns();
+
+		pool.run(update_read_job< LAYOUT_T >::run, &job, num_chunk);
+
+		const uint64_t dt = timer_ns() - t0;
+
+		report_searches(dt, rep, size);
+
+		for (size_t i = 1; i < threads; ++i)
+			histogram[0].merge(histogram[i]);
+
+		report_latency(histogram[0]);
+
+		if (!pass)
+			continue;
+
+		__atomic_store_n(&writer.stop, true, __ATOMIC_RELAXED);
+		pthread_join(thread, 0);
+
+		printf("updates applied: " FMT_ULONG ", rebuilds: " FMT_ULONG ", base keys: " FMT_ULONG ", delta entries: " FMT_ULONG "\n",
+			writer.count, index.rebuilds(), index.base_size(), index.delta_size());
+
+		for (size_t i = 0; i < size * 2; ++i)
+			if (index.contains(0, searchitem_t(i * .5f)) != bool(present[i])) {
+				fprintf(stderr, "error: updatable index FAILURE at key %f\n", i * .5f);
+				return -1;
+			}
+	}
+
+	return 0;
+}
+
+static const size_t merge_batch_period = 20; // number of keys in the index per key of the merged batch
+
+template < typename INDEX_T >
+static int bench_merge(
+	const INDEX_T& index,
+	const typename INDEX_T::key_type* const src,
+	const size_t rep)
+{
+	typedef typename INDEX_T::key_type key_type;
+
+	// a batch of midpoints between keys of the index, one per merge_batch_period keys
+	const size_t size = index.size();
+	const size_t len_batch = max(size / merge_batch_period, size_t(1));
+	const size_t new_len = size + len_batch;
+	const size_t num_rep = max(rep / new_len, size_t(1));
+
+	aligned_ptr< key_type, alignment > batch(len_batch);
+	aligned_ptr< key_type, alignment > merged(new_len);
+
+	for (size_t i = 0; i < len_batch; ++i)
+		batch[i] = src[min(i * merge_batch_period, size - 1)] + key_type(.5f);
+
+	INDEX_T target;
+	uint64_t dt_merge = 0;
+	uint64_t dt_build = 0;
+
+	printf("merging " FMT_ULONG " keys into " FMT_ULONG " keys vs building from scratch, " FMT_ULONG " repetitions..\n",
+		len_batch, size, num_rep);
+
+	for (size_t n = 0; n < num_rep; ++n) {
+		INDEX_T base;
+
+		if (!base.build(src, size)) {
+			fprintf(stderr, "error: failed to build index of size " FMT_ULONG "\n", size);
+			return -1;
+		}
+
+		const uint64_t t0 = timer_ns();
+
+		if (!base.merge(batch, len_batch)) {
+			fprintf(stderr, "error: failed to merge " FMT_ULONG " keys\n", len_batch);
+			return -1;
+		}
+
+		const uint64_t t1 = timer_ns();
+
+		// from scratch: materialise the merged keys, then lay them out
+		for (size_t i = 0, j = 0, r = 0; r < new_len; ++r)
+			merged[r] = j == len_batch || i < size && !(batch[j] < src[i]) ? src[i++] : batch[j++];
+
+		if (!target.build(merged, new_len)) {
+			fprintf(stderr, "error: failed to build index of size " FMT_ULONG "\n", new_len);
+			return -1;
+		}
+
+		const uint64_t t2 = timer_ns();
+
+		dt_merge += t1 - t0;
+		dt_build += t2 - t1;
+
+		if (base.size() != target.size() || base.storage_size() != target.storage_size() ||
+			memcmp(base.data(), target.data(), base.storage_size() * sizeof(key_type))) {
+			fprintf(stderr, "error: merged index FAILURE, repetition " FMT_ULONG "\n", n);
+			return -1;
+		}
+	}
+
+	if (dt_merge && dt_build) {
+		printf("merge elapsed time: %f, keys/s: %f\n", dt_merge * 1e-9, double(new_len) * num_rep / (dt_merge * 1e-9));
+		printf("build elapsed time: %f, keys/s: %f\n", dt_build * 1e-9, double(new_len) * num_rep / (dt_build * 1e-9));
+	}
+
+	return 0;
+}
+
+// bytes read from storage by the process so far, or uint64_t(-1) where unsupported
+static uint64_t storage_read_bytes()
+{
+	FILE* const f = fopen("/proc/self/io", "r");
+
+	if (0 == f)
+		return uint64_t(-1);
+
+	char line[128];
+	uint64_t bytes = uint64_t(-1);
+
+	while (fgets(line, sizeof(line), f))
+		if (0 == strncmp(line, "read_bytes:", 11)) {
+			bytes = strtoull(line + 11, 0, 10);
+			break;
+		}
+
+	fclose(f);
+	return bytes;
+}
+
+// resident set size of the process and its peak since the last reset_peak_resident(), in bytes, or 0 where
+// unsupported
+static size_t resident_bytes(
+	const bool peak)
+{
+	FILE* const f = fopen("/proc/self/status", "r");
+
+	if (0 == f)
+		return 0;
+
+	const char* const field = peak ? "VmHWM:" : "VmRSS:";
+	char line[128];
+	size_t bytes = 0;
+
+	while (fgets(line, sizeof(line), f))
+		if (0 == strncmp(line, field, strlen(field))) {
+			bytes = size_t(strtoull(line + strlen(field), 0, 10)) * 1024;
+			break;
+		}
+
+	fclose(f);
+	return bytes;
+}
+
+// reset the peak resident set size of the process to the current one; return false where unsupported
+static bool reset_peak_resident()
+{
+	FILE* const f = fopen("/proc/self/clear_refs", "w");
+
+	if (0 == f)
+		return false;
+
+	const bool success = 0 <= fputs("5", f);
+	return 0 == fclose(f) && success;
+}
+
+template < typename LAYOUT_T >
+static int bench_file(
+	const search::index< searchitem_t, LAYOUT_T >& index,
+	const searchitem_t* const src,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options)
+{
+	typedef search::paged_index< searchitem_t, LAYOUT_T > paged_type;
+
+	const size_t size = index.size();
+
+	printf("writing " FMT_ULONG " keys to %s..\n", size, options.file);
+
+	if (!paged_type::write_file(options.file, src, size)) {
+		fprintf(stderr, "error: failed to write %s\n", options.file);
+		return -1;
+	}
+
+	aligned_ptr< size_t, alignment > result(rep);
+	int res = 0;
+
+	// scalar mmap, batched mmap at depth, then pread at depths 1 and depth
+	for (size_t run = 0; run < 4 && 0 == res; ++run) {
+		const search::paged_backend backend = run < 2 ? search::paged_mmap : search::paged_pread;
+		const size_t depth = 0 == run ? 0 : 2 == run ? 1 : options.depth;
+		const char* const backend_name = run < 2 ? "mmap" : "pread";
+
+		paged_type paged;
+
+		if (!paged.open(options.file, backend, true)) {
+			fprintf(stderr, "error: failed to open %s\n", options.file);
+			res = -1;
+			break;
+		}
+
+		thread_pool pool;
+
+		if (depth && !pool.init(depth)) {
+			fprintf(stderr, "error: failed to start " FMT_ULONG " threads\n", depth);
+			res = -1;
+			break;
+		}
+
+		if (depth)
+			printf("searching " FMT_ULONG " pages via %s, cold, " FMT_ULONG " threads..\n", paged.pages(), backend_name, depth);
+		else
+			printf("searching " FMT_ULONG " pages via %s, cold, one key at a time..\n", paged.pages(), backend_name);
+
+		const uint64_t bytes0 = storage_read_bytes();
+		const uint64_t t0 = timer_ns();
+
+		if (depth)
+			paged.lower_bound(pool, sample, rep, result);
+		else
+			for (size_t i = 0; i < rep; ++i)
+				result[i] = paged.lower_bound(sample[i]);
+
+		report_searches(timer_ns() - t0, rep, size);
+
+		const uint64_t bytes1 = storage_read_bytes();
+
+		if (uint64_t(-1) != bytes0 && uint64_t(-1) != bytes1)
+			printf("storage page reads/lookup: %f\n", double(bytes1 - bytes0) / paged_type::page_size / rep);
+
+		if (search::paged_pread == backend)
+			printf("pread calls/lookup: %f\n", double(paged.reads()) / rep);
+
+		for (size_t i = 0; i < rep; ++i)
+			if (result[i] != index.lower_bound(sample[i])) {
+				fprintf(stderr, "error: paged search FAILURE at " FMT_ULONG "\n", i);
+				res = -1;
+				break;
+			}
+	}
+
+	unlink(options.file);
+	return res;
+}
+
+// keys of the packed mode: dense 64-bit ids, one of each three in a range far from zero
+static const uint64_t packed_key_base = uint64_t(1) << 40;
+
+static uint64_t packed_key(
+	const size_t i)
+{
+	return packed_key_base + i * 3 + (i * 0x9e3779b9U >> 7) % 3;
+}
+
+template < typename LAYOUT_T >
+static int bench_packed(
+	const size_t size,
+	const searchitem_t* const sample,
+	const size_t rep)
+{
+	typedef search::packed_index< uint64_t, LAYOUT_T > packed_type;
+
+	aligned_ptr< uint64_t, alignment > src(size);
+	aligned_ptr< uint64_t, alignment > key(rep);
+
+	for (size_t i = 0; i < size; ++i)
+		src[i] = packed_key(i);
+
+	// about one in three keys hit
+	for (size_t i = 0; i < rep; ++i)
+		key[i] = packed_key_base + uint64_t(sample[i]) * 3 + i % 3;
+
+	packed_type packed;
+
+	if (!packed.build(src, size)) {
+		fprintf(stderr, "error: failed to build packed_index of size " FMT_ULONG "\n", size);
+		return -1;
+	}
+
+	printf("verifying packed_index consistency..\n");
+
+	for (size_t i = 0; i < size; ++i)
+		if (packed.find(src[i]) != i) {
+			fprintf(stderr, "error: packed search FAILURE at key " FMT_ULONG "\n", i);
+			return -1;
+		}
+
+	for (size_t i = 0; i < rep; ++i)
+		if (packed.lower_bound(key[i]) != search::blowerbound_standard(static_cast< const uint64_t* >(src), size, key[i])) {
+			fprintf(stderr, "error: packed lower-bound search FAILURE at " FMT_ULONG "\n", i);
+			return -1;
+		}
+
+	printf("packed bytes/key: %f, raw bytes/key: %f\n",
+		double(packed.storage_bytes()) / size, double(sizeof(uint64_t)));
+
+	printf("packed searching..\n");
+
+	const uint64_t t0 = timer_ns();
+
+	for (size_t i = 0; i < rep; ++i)
+		found[i * obfuscator] = packed.find(key[i]);
+
+	report_searches(timer_ns() - t0, rep, size);
+
+	printf("packed batch searching..\n");
+
+	size_t result[batch_size];
+	const uint64_t t1 = timer_ns();
+
+	for (size_t i = 0; i < rep; i += batch_size) {
+		const size_t count = min(batch_size, rep - i);
+
+		packed.find(key + i, count, result);
+		found[i * obfuscator] = result[count - 1];
+	}
+
+	report_searches(timer_ns() - t1, rep, size);
+
+	// the raw keys in a VEB layout, searched by bsearch_veb_iter where the depth of the tree allows, else by the
+	// lower-bound routine of the layout
+	const size_t space_size = search::tree_space_size(size);
+	const size_t log2_size = log2_from_pot(space_size);
+	const size_t total_size = search::veb_total_size(space_size, size_t(1) << log2_subsize);
+	aligned_ptr< uint64_t, alignment > padded(space_size);
+	aligned_ptr< uint64_t, alignment > veb(total_size);
+
+	for (size_t i = 0; i < space_size; ++i)
+		padded[i] = src[min(i, size - 1)];
+
+	search::prepare_for_veb_search(static_cast< uint64_t* >(veb), total_size, static_cast< const uint64_t* >(padded),
+		space_size, size_t(1) << log2_subsize);
+
+	const bool iter = 0 == log2_size % log2_subsize;
+
+	printf("raw VEB bytes/key: %f\n", double(total_size * sizeof(uint64_t)) / size);
+	printf("raw VEB searching via %s..\n", iter ? "bsearch_veb_iter" : "blowerbound_veb");
+
+	const uint64_t t2 = timer_ns();
+
+	if (iter)
+		for (size_t i = 0; i < rep; ++i)
+			found[i * obfuscator] = search::bsearch_veb_iter< log2_subsize >(static_cast< const uint64_t* >(veb), space_size, key[i]);
+	else
+		for (size_t i = 0; i < rep; ++i) {
+			size_t pos;
+			found[i * obfuscator] = search::blowerbound_veb< log2_subsize >(static_cast< const uint64_t* >(veb), space_size, key[i], pos);
+		}
+
+	report_searches(timer_ns() - t2, rep, size);
+
+	return 0;
+}
+
+// Mode dups: the occurrence counts of keys of options.dups occurrences each, by the equal_range of search::index,
+// i.e. a lower- and an upper-bound search, vs the naive way of finding a first occurrence and scanning past the
+// last one.
+template < typename LAYOUT_T >
+static int bench_dups(
+	const size_t size,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options)
+{
+	const size_t dups = options.dups;
+	const size_t num_distinct = (size + dups - 1) / dups;
+
+	aligned_ptr< searchitem_t, alignment > src(size);
+
+	for (size_t i = 0; i < size; ++i)
+		src[i] = searchitem_t(i / dups);
+
+	search::index< searchitem_t, LAYOUT_T > index;
+
+	if (!index.build(src, size)) {
+		fprintf(stderr, "error: failed to build index of size " FMT_ULONG "\n", size);
+		return -1;
+	}
+
+	printf("verifying equal_range consistency, " FMT_ULONG " keys of " FMT_ULONG " occurrences..\n", num_distinct, dups);
+
+	// present keys, absent keys between them, and keys past both ends
+	for (size_t v = 0; v <= num_distinct; ++v)
+		for (size_t j = 0; j < 2; ++j) {
+			const searchitem_t key = j ? searchitem_t(v) - .5f : searchitem_t(v);
+			const searchitem_t* const begin = src;
+			const std::pair< const searchitem_t*, const searchitem_t* > ref = std::equal_range(begin, begin + size, key);
+			size_t first, last;
+
+			index.equal_range(key, first, last);
+
+			if (first != size_t(ref.first - begin) || last != size_t(ref.second - begin)) {
+				fprintf(stderr, "error: equal_range FAILURE at key %f\n", double(key));
+				return -1;
+			}
+		}
+
+	aligned_ptr< searchitem_t, alignment > key(rep);
+
+	for (size_t i = 0; i < rep; ++i)
+		key[i] = searchitem_t(size_t(sample[i]) / dups);
+
+	printf("counting by equal_range..\n");
+
+	size_t total_range = 0;
+	const uint64_t t0 = timer_ns();
+
+	for (size_t i = 0; i < rep; ++i) {
+		size_t first, last;
+
+		index.equal_range(key[i], first, last);
+		found[i * obfuscator] = last - first;
+		total_range += last - first;
+	}
+
+	report_searches(timer_ns() - t0, rep, size);
+
+	printf("counting by find then scan..\n");
+
+	size_t total_scan = 0;
+	const uint64_t t1 = timer_ns();
+
+	for (size_t i = 0; i < rep; ++i) {
+		const size_t first = index.find(key[i]);
+		size_t last = first;
+
+		if (search::index< searchitem_t, LAYOUT_T >::npos != first)
+			while (last < size && src[last] == key[i])
+				++last;
+
+		found[i * obfuscator] = last - first;
+		total_scan += last - first;
+	}
+
+	report_searches(timer_ns() - t1, rep, size);
+
+	if (total_range != total_scan) {
+		fprintf(stderr, "error: occurrence count FAILURE: " FMT_ULONG " vs " FMT_ULONG "\n", total_range, total_scan);
+		return -1;
+	}
+
+	return 0;
+}
+
+// Mode range: sums of the keys of ranges of 10 and 10000 keys starting at the keys of the sample, scanned by
+// search::index cursors vs scanned in the plain sorted array from a standard lower-bound search; the counts of the
+// same ranges by search::index::count_range are checked afterwards.
+template < typename INDEX_T >
+static int bench_range(
+	const INDEX_T& index,
+	const searchitem_t* const src,
+	const searchitem_t* const sample,
+	const size_t rep)
+{
+	const size_t size = index.size();
+	const size_t range_len[] = { 10, 10000 };
+
+	printf("verifying cursor consistency..\n");
+
+	for (typename INDEX_T::cursor it = index.at(0); it.valid(); it.next())
+		if (src[it.position()] != it.key()) {
+			fprintf(stderr, "error: cursor FAILURE at position " FMT_ULONG "\n", it.position());
+			return -1;
+		}
+
+	for (size_t l = 0; l < sizeof(range_len) / sizeof(range_len[0]); ++l) {
+		const size_t len = range_len[l];
+		const size_t num_range = rep / len ? rep / len : 1;
+
+		printf("scanning " FMT_ULONG " ranges of " FMT_ULONG " keys by cursor..\n", num_range, len);
+
+		double sum_cursor = 0;
+		size_t num_cursor = 0;
+		const uint64_t t0 = timer_ns();
+
+		for (size_t i = 0; i < num_range; ++i) {
+			const searchitem_t lo = sample[i];
+			const searchitem_t hi = lo + searchitem_t(len);
+			double sum = 0;
+			size_t n = 0;
+
+			for (typename INDEX_T::cursor it = index.scan(lo); it.valid() && it.key() < hi; it.next(), ++n)
+				sum += double(it.key());
+
+			found[i * obfuscator] = n;
+			sum_cursor += sum;
+			num_cursor += n;
+		}
+
+		const uint64_t dt0 = timer_ns() - t0;
+
+		printf("scanning " FMT_ULONG " ranges of " FMT_ULONG " keys in the sorted array..\n", num_range, len);
+
+		double sum_array = 0;
+		size_t num_array = 0;
+		const uint64_t t1 = timer_ns();
+
+		for (size_t i = 0; i < num_range; ++i) {
+			const searchitem_t lo = sample[i];
+			const searchitem_t hi = lo + searchitem_t(len);
+			const size_t first = search::blowerbound_standard(src, size, lo);
+			double sum = 0;
+			size_t n = first;
+
+			for (; n < size && src[n] < hi; ++n)
+				sum += double(src[n]);
+
+			found[i * obfuscator] = n - first;
+			sum_array += sum;
+			num_array += n - first;
+		}
+
+		const uint64_t dt1 = timer_ns() - t1;
+
+		if (sum_cursor != sum_array || num_cursor != num_array) {
+			fprintf(stderr, "error: range scan FAILURE: " FMT_ULONG " vs " FMT_ULONG " keys\n", num_cursor, num_array);
+			return -1;
+		}
+
+		size_t num_count = 0;
+
+		for (size_t i = 0; i < num_range; ++i)
+			num_count += index.count_range(sample[i], sample[i] + searchitem_t(len));
+
+		if (num_count != num_array) {
+			fprintf(stderr, "error: count_range FAILURE: " FMT_ULONG " vs " FMT_ULONG " keys\n", num_count, num_array);
+			return -1;
+		}
+
+		printf("cursor: %.3f ranges/s, %.3f keys/s\narray:  %.3f ranges/s, %.3f keys/s\n",
+			num_range / (dt0 * 1e-9), num_cursor / (dt0 * 1e-9),
+			num_range / (dt1 * 1e-9), num_array / (dt1 * 1e-9));
+	}
+
+	return 0;
+}
+
+// table starts of mode segmented and of the tables of traces: table t takes space_size / 2 up to space_size - 1
+// keys, by a hash of t
+static void segmented_starts(
+	const size_t space_size,
+	const size_t num_table,
+	size_t* const start)
+{
+	const size_t half = space_size / 2 ? space_size / 2 : 1;
+
+	start[0] = 0;
+
+	for (size_t t = 0; t < num_table; ++t)
+		start[t + 1] = start[t] + half + (t * 0x9e3779b9U >> 7) % half;
+}
+
+static const size_t segmented_max_key = size_t(1) << 26; // largest total key count of the tables of modes segmented and replay
+
+// Mode segmented: lookups of keys in random tables of options.tables small tables, each of space_size / 2 up to
+// space_size keys, as the rows of a tabulated distribution would be, in a search::segmented_index of the layout
+// vs in per-table allocations of breadth-first layout searched by bnearsearch_breadth; the build times count the
+// allocations.
+template < typename LAYOUT_T >
+static int bench_segmented(
+	const size_t space_size,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options)
+{
+	const size_t num_table = options.tables;
+
+	aligned_ptr< size_t, alignment > start(num_table + 1);
+
+	segmented_starts(space_size, num_table, start);
+
+	const size_t size = start[num_table];
+
+	if (segmented_max_key < size) {
+		fprintf(stderr, "error: %s %s requires a smaller %s or %s\n", arg_mode, mode_name[mode_segmented], arg_space_size, arg_tables);
+		return -1;
+	}
+
+	aligned_ptr< searchitem_t, alignment > src(size);
+
+	for (size_t t = 0; t < num_table; ++t)
+		for (size_t i = start[t]; i < start[t + 1]; ++i)
+			src[i] = searchitem_t(i - start[t]);
+
+	printf("building " FMT_ULONG " tables of " FMT_ULONG " keys in total..\n", num_table, size);
+
+	search::segmented_index< searchitem_t, LAYOUT_T > segmented;
+	const uint64_t t0 = timer_ns();
+
+	if (!segmented.build(src, start, num_table + 1)) {
+		fprintf(stderr, "error: failed to build segmented_index of size " FMT_ULONG "\n", size);
+		return -1;
+	}
+
+	const uint64_t dt0 = timer_ns() - t0;
+	aligned_ptr< searchitem_t, alignment >* const table = new aligned_ptr< searchitem_t, alignment >[num_table];
+	aligned_ptr< size_t, alignment > table_size(num_table);
+	const uint64_t t1 = timer_ns();
+
+	for (size_t t = 0; t < num_table; ++t) {
+		const size_t len = start[t + 1] - start[t];
+		aligned_ptr< searchitem_t, alignment > padded;
+
+		table_size[t] = search::tree_space_size(len);
+		table[t].malloc(table_size[t]);
+		search::prepare_for_breadth_search(static_cast< searchitem_t* >(table[t]), table_size[t],
+			search::pad_for_tree(padded, src + start[t], len, table_size[t]), table_size[t]);
+	}
+
+	const uint64_t dt1 = timer_ns() - t1;
+
+	printf("segmented build: %f s, " FMT_ULONG " bytes\nper-table build: %f s\n",
+		dt0 * 1e-9, segmented.storage_bytes(), dt1 * 1e-9);
+
+	aligned_ptr< uint32_t, alignment > table_id(rep);
+	aligned_ptr< searchitem_t, alignment > key(rep);
+	unsigned seed = 42;
+
+	for (size_t i = 0; i < rep; ++i) {
+		table_id[i] = uint32_t(rnd::rand_r(&seed) % num_table);
+		key[i] = searchitem_t(size_t(sample[i]) % segmented.size(table_id[i]));
+	}
+
+	printf("verifying segmented_index consistency..\n");
+
+	for (size_t i = 0; i < rep; ++i) {
+		const size_t t = table_id[i];
+		const size_t rank = segmented.find(t, key[i]);
+		size_t pos;
+
+		search::bnearsearch_breadth(static_cast< const searchitem_t* >(table[t]), table_size[t], key[i], pos);
+
+		if (search::segmented_index< searchitem_t, LAYOUT_T >::npos == rank || src[start[t] + rank] != key[i] || table[t][pos] != key[i]) {
+			fprintf(stderr, "error: segmented_index FAILURE at table " FMT_ULONG ", key %f\n", t, double(key[i]));
+			delete [] table;
+			return -1;
+		}
+	}
+
+	printf("searching per-table allocations..\n");
+
+	const uint64_t t2 = timer_ns();
+
+	for (size_t i = 0; i < rep; ++i) {
+		const size_t t = table_id[i];
+		size_t pos;
+
+		search::bnearsearch_breadth(static_cast< const searchitem_t* >(table[t]), table_size[t], key[i], pos);
+		found[i * obfuscator] = pos;
+	}
+
+	report_searches(timer_ns() - t2, rep, size);
+
+	printf("searching segmented_index..\n");
+
+	const uint64_t t3 = timer_ns();
+
+	for (size_t i = 0; i < rep; ++i)
+		found[i * obfuscator] = segmented.find(table_id[i], key[i]);
+
+	report_searches(timer_ns() - t3, rep, size);
+
+	printf("batch searching segmented_index..\n");
+
+	size_t result[batch_size];
+	const uint64_t t4 = timer_ns();
+
+	for (size_t i = 0; i < rep; i += batch_size) {
+		const size_t count = min(batch_size, rep - i);
+
+		segmented.find(table_id + i, key + i, count, result);
+		found[i * obfuscator] = result[count - 1];
+	}
+
+	report_searches(timer_ns() - t4, rep, size);
+
+	delete [] table;
+	return 0;
+}
+
+// Mode radix: build of a search::index from size unsorted keys, about two thirds of them distinct, negatives
+// included, by search::radix_build over options.threads threads vs copying, sorting and deduplicating the keys,
+// then building the index from the sorted keys, e.g. by prepare_for_veb_search for the VEB layout. The time and
+// the growth of the peak resident set of each build are reported, and the two indexes are checked to be equal.
+template < typename LAYOUT_T >
+static int bench_radix(
+	const size_t size,
+	const Options& options)
+{
+	typedef search::index< searchitem_t, LAYOUT_T > index_type;
+
+	aligned_ptr< searchitem_t, alignment > key(size);
+	unsigned seed = 1;
+
+	for (size_t i = 0; i < size; ++i)
+		key[i] = searchitem_t(int64_t(rnd::rand_r(&seed) % size) - int64_t(size / 2));
+
+	thread_pool pool;
+
+	if (!pool.init(options.threads)) {
+		fprintf(stderr, "error: failed to start " FMT_ULONG " threads\n", options.threads);
+		return -1;
+	}
+
+	printf("building from " FMT_ULONG " unsorted keys by radix sort, " FMT_ULONG " threads..\n", size, options.threads);
+
+	index_type radix;
+	const bool peak = reset_peak_resident();
+	const size_t rss0 = resident_bytes(false);
+	const uint64_t t0 = timer_ns();
+
+	if (!search::radix_build(pool, radix, static_cast< const searchitem_t* >(key), size)) {
+		fprintf(stderr, "error: failed to radix-build index of size " FMT_ULONG "\n", size);
+		return -1;
+	}
+
+	const uint64_t dt0 = timer_ns() - t0;
+	const size_t peak0 = resident_bytes(true) - rss0;
+
+	printf("building from " FMT_ULONG " unsorted keys by sort then build..\n", size);
+
+	index_type sorted;
+	reset_peak_resident();
+	const size_t rss1 = resident_bytes(false);
+	const uint64_t t1 = timer_ns();
+
+	{
+		aligned_ptr< searchitem_t, alignment > src(size);
+		memcpy(src, key, size * sizeof(searchitem_t));
+
+		searchitem_t* const begin = src;
+		std::sort(begin, begin + size);
+		const size_t len = std::unique(begin, begin + size) - begin;
+
+		if (!sorted.build(src, len)) {
+			fprintf(stderr, "error: failed to build index of size " FMT_ULONG "\n", len);
+			return -1;
+		}
+	}
+
+	const uint64_t dt1 = timer_ns() - t1;
+	const size_t peak1 = resident_bytes(true) - rss1;
+
+	printf("verifying radix-built index consistency, " FMT_ULONG " distinct keys..\n", radix.size());
+
+	if (radix.size() != sorted.size() || memcmp(radix.data(), sorted.data(), sorted.storage_size() * sizeof(searchitem_t))) {
+		fprintf(stderr, "error: radix build FAILURE\n");
+		return -1;
+	}
+
+	printf("radix build: %f s, keys/s: %f\nsort build:  %f s, keys/s: %f\n",
+		dt0 * 1e-9, size / (dt0 * 1e-9), dt1 * 1e-9, size / (dt1 * 1e-9));
+
+	if (peak)
+		printf("radix build peak memory growth: " FMT_ULONG " bytes\nsort build peak memory growth:  " FMT_ULONG " bytes\n", peak0, peak1);
+
+	return 0;
+}
+
+// Mode filter: exact-match searches of the sample keys, a share of them made absent, in a search::index vs in a
+// search::filtered_index of the same keys with a Bloom filter of options.bits bits per key, over miss ratios from
+// 0% through 100%; the false-positive ratio of the filter, the break-even miss ratio and the size of the filter
+// relative to the index are reported.
+template < typename LAYOUT_T >
+static int bench_filter(
+	const search::index< searchitem_t, LAYOUT_T >& index,
+	const searchitem_t* const src,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options)
+{
+	typedef search::filtered_index< searchitem_t, LAYOUT_T > filtered_type;
+
+	const size_t size = index.size();
+	filtered_type filtered;
+
+	if (!filtered.build(src, size, options.bits)) {
+		fprintf(stderr, "error: failed to build filtered_index of size " FMT_ULONG "\n", size);
+		return -1;
+	}
+
+	printf("filter: " FMT_ULONG " bytes, %.2f bits per key, %.1f%% of the index\n", filtered.filter_bytes(),
+		filtered.filter_bytes() * 8.0 / size, filtered.filter_bytes() * 100.0 / filtered.index_bytes());
+
+	aligned_ptr< searchitem_t, alignment > key(rep);
+	double prev_ratio = 0;
+	double prev_gain = 0;
+	double break_even = -1;
+
+	for (size_t miss = 0; miss <= 100; miss += 10) {
+		size_t num_miss = 0;
+		size_t num_false = 0;
+
+		// absent keys fall halfway between present ones
+		for (size_t i = 0; i < rep; ++i) {
+			const bool absent = (i * 0x9e3779b9U >> 7) % 100 < miss;
+
+			key[i] = searchitem_t(size_t(sample[i]) % size) + (absent ? .5f : 0.f);
+			num_miss += absent;
+		}
+
+		printf("miss ratio %3lu%%..\n", (unsigned long) miss);
+
+		size_t hits_plain = 0;
+		const uint64_t t0 = timer_ns();
+
+		for (size_t i = 0; i < rep; ++i) {
+			const size_t res = index.find(key[i]);
+
+			found[i * obfuscator] = res;
+			hits_plain += filtered_type::npos != res;
+		}
+
+		const uint64_t dt0 = timer_ns() - t0;
+
+		size_t hits_filtered = 0;
+		const uint64_t t1 = timer_ns();
+
+		for (size_t i = 0; i < rep; ++i) {
+			const size_t res = filtered.find(key[i]);
+
+			found[i * obfuscator] = res;
+			hits_filtered += filtered_type::npos != res;
+		}
+
+		const uint64_t dt1 = timer_ns() - t1;
+
+		if (hits_plain != hits_filtered || hits_plain != rep - num_miss) {
+			fprintf(stderr, "error: filtered_index FAILURE: " FMT_ULONG " vs " FMT_ULONG " hits\n", hits_filtered, hits_plain);
+			return -1;
+		}
+
+		for (size_t i = 0; i < rep; ++i)
+			num_false += filtered.may_contain(key[i]) && searchitem_t(size_t(key[i])) != key[i];
+
+		const double plain = rep / (dt0 * 1e-9);
+		const double with_filter = rep / (dt1 * 1e-9);
+		const double gain = with_filter / plain - 1;
+
+		printf("without filter: %f searches/s\nwith filter:    %f searches/s (%+.1f%%), false positives: %.2f%%\n",
+			plain, with_filter, gain * 100, num_miss ? num_false * 100.0 / num_miss : 0.0);
+
+		if (0 > break_even && 0 <= gain)
+			break_even = 0 == miss || prev_gain == gain ? miss : prev_ratio + (miss - prev_ratio) * -prev_gain / (gain - prev_gain);
+
+		prev_ratio = miss;
+		prev_gain = gain;
+	}
+
+	if (0 <= break_even)
+		printf("break-even miss ratio: %.1f%%\n", break_even);
+	else
+		printf("break-even miss ratio: none\n");
+
+	return 0;
+}
+
+// Sampler of the ranks 1 through n of a Zipf distribution of exponent s >= 0, by rejection-inversion (Hoermann and
+// Derflinger, 1996), in constant time and space per sample
+class zipf_sampler
+{
+	double s;
+	double n;
+	double h_x1;      // integral of the hat function from 1.5 down, less 1
+	double h_n;       // integral of the hat function up to n + .5
+	double threshold; // acceptance bound of the squeeze
+	unsigned seed;
+
+	// log(1 + x) / x and (exp(x) - 1) / x, accurate near zero
+	static double helper1(
+		const double x)
+	{
+		return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (.5 - x * (1. / 3 - x * .25));
+	}
+
+	static double helper2(
+		const double x)
+	{
+		return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * .5 * (1 + x * (1. / 3) * (1 + x * .25));
+	}
+
+	double h(
+		const double x) const
+	{
+		return exp(-s * log(x));
+	}
+
+	double h_integral(
+		const double x) const
+	{
+		const double log_x = log(x);
+		return helper2((1 - s) * log_x) * log_x;
+	}
+
+	double h_integral_inv(
+		const double x) const
+	{
+		const double t = x * (1 - s) < -1 ? -1 : x * (1 - s);
+		return exp(helper1(t) * x);
+	}
+
+public:
+	zipf_sampler(
+		const size_t n,
+		const double s,
+		const unsigned seed)
+	: s(s)
+	, n(double(n))
+	, seed(seed)
+	{
+		h_x1 = h_integral(1.5) - 1;
+		h_n = h_integral(n + .5);
+		threshold = 2 - h_integral_inv(h_integral(2.5) - h(2));
+	}
+
+	size_t operator ()()
+	{
+		for (;;) {
+			// rand_r yields 31 random bits
+			const double u = h_n + rnd::rand_r(&seed) / 2147483648. * (h_x1 - h_n);
+			const double x = h_integral_inv(u);
+			const double k = x + .5 < 1 ? 1 : x + .5 > n ? n : floor(x + .5);
+
+			if (k - x <= threshold || u >= h_integral(k + .5) - h(k))
+				return size_t(k);
+		}
+	}
+};
+
+// Mode cache: exact-match searches of keys drawn by Zipf distributions of rising skew, the most frequent keys
+// scattered over the index, in a search::index vs in a search::cached_index of the same keys, the cache flushed
+// by a rebuild at each skew; the hit rate of the cache is reported. Last, the index is rebuilt from other keys
+// with the cache warm, and all searches are checked to see the new keys.
+template < typename LAYOUT_T >
+static int bench_cache(
+	const search::index< searchitem_t, LAYOUT_T >& index,
+	const searchitem_t* const src,
+	const size_t rep)
+{
+	typedef search::cached_index< searchitem_t, LAYOUT_T > cached_type;
+
+	const size_t size = index.size();
+	const double skew[] = { 0, .5, .8, .99, 1.2 };
+	aligned_ptr< searchitem_t, alignment > key(rep);
+	cached_type cached;
+
+	for (size_t j = 0; j < sizeof(skew) / sizeof(skew[0]); ++j) {
+		zipf_sampler zipf(size, skew[j], 42);
+
+		for (size_t i = 0; i < rep; ++i)
+			key[i] = searchitem_t((zipf() - 1) * 2654435761ULL % size);
+
+		if (!cached.build(src, size)) {
+			fprintf(stderr, "error: failed to build cached_index of size " FMT_ULONG "\n", size);
+			return -1;
+		}
+
+		printf("skew %.2f, " FMT_ULONG " bytes of cache..\n", skew[j], cached.cache_bytes());
+
+		size_t sum_plain = 0;
+		const uint64_t t0 = timer_ns();
+
+		for (size_t i = 0; i < rep; ++i) {
+			const size_t res = index.find(key[i]);
+
+			found[i * obfuscator] = res;
+			sum_plain += res;
+		}
+
+		const uint64_t dt0 = timer_ns() - t0;
+
+		size_t sum_cached = 0;
+		size_t hits = 0;
+		const uint64_t t1 = timer_ns();
+
+		for (size_t i = 0; i < rep; ++i) {
+			bool hit;
+			const size_t res = cached.find(key[i], hit);
+
+			found[i * obfuscator] = res;
+			sum_cached += res;
+			hits += hit;
+		}
+
+		const uint64_t dt1 = timer_ns() - t1;
+
+		if (sum_plain != sum_cached) {
+			fprintf(stderr, "error: cached_index FAILURE at skew %f\n", skew[j]);
+			return -1;
+		}
+
+		printf("without cache: %f searches/s\nwith cache:    %f searches/s, hit rate: %.2f%%\n",
+			rep / (dt0 * 1e-9), rep / (dt1 * 1e-9), hits * 100.0 / rep);
+	}
+
+	printf("verifying cache invalidation on rebuild..\n");
+
+	if (!cached.build(src + 1, size - 1)) {
+		fprintf(stderr, "error: failed to build cached_index of size " FMT_ULONG "\n", size - 1);
+		return -1;
+	}
+
+	for (size_t i = 0; i < rep; ++i) {
+		const size_t expected = 0 == key[i] ? cached_type::npos : size_t(key[i]) - 1;
+
+		if (cached.find(key[i]) != expected) {
+			fprintf(stderr, "error: stale cached_index result at key %f\n", double(key[i]));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+// levels of a complete binary search tree of the specified depth, as the balanced layouts are, that a search of
+// the key of the in-order rank touches
+static size_t balanced_levels(
+	const size_t log2_size,
+	const size_t rank)
+{
+	return log2_size - __builtin_ctzl(rank + 1);
+}
+
+// Mode weighted: a search::weighted_tree built from a profile of the query stream, the counts of the keys of a
+// Zipf-distributed sample, at every skew; then another sample of the same distribution searched in it vs in the
+// index, which is balanced. The tree levels and the blocks of 16 keys touched per search, as the profile expects
+// and as the searches measure, are reported for both, blocks of the balanced tree being VEB subtrees.
+template < typename LAYOUT_T >
+static int bench_weighted(
+	const search::index< searchitem_t, LAYOUT_T >& index,
+	const searchitem_t* const src,
+	const size_t space_size,
+	const size_t rep)
+{
+	typedef search::weighted_tree< searchitem_t > tree_type;
+
+	const size_t size = index.size();
+	const size_t log2_size = log2_from_pot(space_size);
+	const double skew[] = { .8, .99, 1.2 };
+	aligned_ptr< searchitem_t, alignment > key(rep);
+	aligned_ptr< size_t, alignment > count(size);
+	tree_type tree;
+
+	for (size_t j = 0; j < sizeof(skew) / sizeof(skew[0]); ++j) {
+		zipf_sampler profile(size, skew[j], 1);
+		zipf_sampler query(size, skew[j], 2);
+
+		memset(count, 0, size * sizeof(count[0]));
+
+		for (size_t i = 0; i < rep; ++i)
+			++count[(profile() - 1) * 2654435761ULL % size];
+
+		if (!tree.build(src, count, size)) {
+			fprintf(stderr, "error: failed to build weighted_tree of size " FMT_ULONG "\n", size);
+			return -1;
+		}
+
+		for (size_t i = 0; i < size; ++i) {
+			const size_t pos = tree.find(src[i]);
+
+			if (tree_type::npos == pos || tree.data()[pos] != src[i] || tree_type::npos != tree.find(searchitem_t(size + i))) {
+				fprintf(stderr, "error: weighted_tree FAILURE at key %f, skew %f\n", double(src[i]), skew[j]);
+				return -1;
+			}
+		}
+
+		printf("skew %.2f, weighted_tree of " FMT_ULONG " blocks, " FMT_ULONG " bytes..\n",
+			skew[j], tree.blocks(), tree.storage_bytes());
+
+		// levels and blocks as the profile expects them
+		double expected_levels = 0;
+		double expected_blocks = 0;
+		double balanced_expected_levels = 0;
+		double balanced_expected_blocks = 0;
+
+		for (size_t i = 0; i < size; ++i) {
+			if (0 == count[i])
+				continue;
+
+			size_t blocks;
+			const size_t levels = tree.levels(src[i], blocks);
+			const size_t balanced = balanced_levels(log2_size, i);
+
+			expected_levels += double(count[i]) * levels;
+			expected_blocks += double(count[i]) * blocks;
+			balanced_expected_levels += double(count[i]) * balanced;
+			balanced_expected_blocks += double(count[i]) * ((balanced + log2_subsize - 1) / log2_subsize);
+		}
+
+		// and as the searches of the other sample measure them
+		size_t measured_levels = 0;
+		size_t measured_blocks = 0;
+		size_t balanced_measured_levels = 0;
+		size_t balanced_measured_blocks = 0;
+
+		for (size_t i = 0; i < rep; ++i) {
+			key[i] = searchitem_t((query() - 1) * 2654435761ULL % size);
+
+			size_t blocks;
+			const size_t levels = tree.levels(key[i], blocks);
+			const size_t balanced = balanced_levels(log2_size, size_t(key[i]));
+
+			measured_levels += levels;
+			measured_blocks += blocks;
+			balanced_measured_levels += balanced;
+			balanced_measured_blocks += (balanced + log2_subsize - 1) / log2_subsize;
+		}
+
+		printf("levels per search, expected vs measured: weighted %.2f vs %.2f, balanced %.2f vs %.2f\n",
+			expected_levels / rep, double(measured_levels) / rep, balanced_expected_levels / rep, double(balanced_measured_levels) / rep);
+		printf("blocks per search, expected vs measured: weighted %.2f vs %.2f, balanced %.2f vs %.2f\n",
+			expected_blocks / rep, double(measured_blocks) / rep, balanced_expected_blocks / rep, double(balanced_measured_blocks) / rep);
+
+		size_t sum_balanced = 0;
+		const uint64_t t0 = timer_ns();
+
+		for (size_t i = 0; i < rep; ++i) {
+			const size_t res = index.find(key[i]);
+
+			found[i * obfuscator] = res;
+			sum_balanced += res == size_t(key[i]);
+		}
+
+		const uint64_t dt0 = timer_ns() - t0;
+
+		size_t sum_weighted = 0;
+		const uint64_t t1 = timer_ns();
+
+		for (size_t i = 0; i < rep; ++i) {
+			const size_t res = tree.find(key[i]);
+
+			found[i * obfuscator] = res;
+			sum_weighted += tree.data()[res] == key[i];
+		}
+
+		const uint64_t dt1 = timer_ns() - t1;
+
+		if (rep != sum_balanced || rep != sum_weighted) {
+			fprintf(stderr, "error: weighted search FAILURE at skew %f\n", skew[j]);
+			return -1;
+		}
+
+		printf("balanced:\n");
+		report_searches(dt0, rep, size);
+		printf("weighted:\n");
+		report_searches(dt1, rep, size);
+	}
+
+	return 0;
+}
+
+static const size_t stream_chunk = 1 << 16; // number of keys per chunk of mode stream
+static int stream_stdout = -1; // descriptor of the original stdout in mode stream, when positions go there
+
+// Mode stream: the keys of the input searched by the batch search of the index as they come, chunk by chunk,
+// reading and writing overlapped with the search; reports end-to-end throughput and how often each stage stalled,
+// the stage stalling least being the bottleneck
+template < typename LAYOUT_T >
+static int bench_stream(
+	const search::index< searchitem_t, LAYOUT_T >& index,
+	const Options& options)
+{
+	typedef search::stream_pipeline< search::index< searchitem_t, LAYOUT_T > > pipeline_type;
+
+	const bool std_in = 0 == strcmp(options.input, "-");
+	const bool std_out = 0 == strcmp(options.output, "-");
+	const int in = std_in ? STDIN_FILENO : open(options.input, O_RDONLY);
+
+	if (0 > in) {
+		fprintf(stderr, "error: failed to open %s\n", options.input);
+		return -1;
+	}
+
+	const int out = std_out ? stream_stdout : open(options.output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (0 > out) {
+		fprintf(stderr, "error: failed to open %s\n", options.output);
+
+		if (!std_in)
+			close(in);
+
+		return -1;
+	}
+
+	pipeline_type pipeline(index, stream_chunk);
+	typename pipeline_type::stats stats;
+	int err = 0;
+
+	fprintf(stderr, "streaming keys from %s to %s, " FMT_ULONG " keys per chunk, " FMT_ULONG " buffers..\n",
+		std_in ? "stdin" : options.input, std_out ? "stdout" : options.output, stream_chunk, pipeline_type::num_buffer);
+
+	const uint64_t t0 = timer_ns();
+	const size_t success = pipeline.run(in, out, stats, err);
+	const uint64_t dt = timer_ns() - t0;
+
+	if (!std_in)
+		close(in);
+
+	if (!std_out && close(out) && success)
+		err = errno;
+
+	if (!success || err) {
+		if (0 > err)
+			fprintf(stderr, "error: input ends in a partial key\n");
+		else
+			fprintf(stderr, "error: stream failed: %s\n", strerror(err));
+
+		return -1;
+	}
+
+	if (dt) {
+		const double sec = double(dt) * 1e-9;
+		fprintf(stderr, "elapsed time: %f (" FMT_ULONG " keys over a space of " FMT_ULONG ")\n", sec, stats.num_key, index.size());
+		fprintf(stderr, "average searches/s: %f, input MB/s: %f\n",
+			stats.num_key / sec, stats.num_key * sizeof(searchitem_t) / sec * 1e-6);
+	}
+
+	fprintf(stderr, "chunks stalled waiting, read: " FMT_ULONG ", search: " FMT_ULONG ", write: " FMT_ULONG "\n",
+		stats.stall[0], stats.stall[1], stats.stall[2]);
+
+	return 0;
+}
+
+// Mode record: the sample written as a trace of queries, as a service would capture its queries; with more than
+// one table, each query goes to a random table, its key wrapped to the keys of the table as in mode segmented;
+// with a nonzero rate, arrivals are a Poisson process of that mean rate
+static int bench_record(
+	const size_t space_size,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options)
+{
+	const size_t num_table = options.tables;
+	const uint32_t fields = (1 < num_table ? search::trace_table : 0) | (options.rate ? search::trace_time : 0);
+
+	aligned_ptr< size_t, alignment > start(num_table + 1);
+
+	segmented_starts(space_size, num_table, start);
+
+	search::trace_writer< searchitem_t > writer;
+
+	if (!writer.open(options.trace, fields)) {
+		fprintf(stderr, "error: failed to create %s\n", options.trace);
+		return -1;
+	}
+
+	printf("recording " FMT_ULONG " queries to %s", rep, options.trace);
+
+	if (1 < num_table)
+		printf(", " FMT_ULONG " tables", num_table);
+
+	if (options.rate)
+		printf(", " FMT_ULONG " queries/s", options.rate);
+
+	printf("..\n");
+
+	unsigned seed = 42;
+	double time = 0;
+
+	for (size_t i = 0; i < rep; ++i) {
+		uint32_t table = 0;
+		searchitem_t key = sample[i];
+
+		if (1 < num_table) {
+			table = uint32_t(rnd::rand_r(&seed) % num_table);
+			key = searchitem_t(size_t(sample[i]) % (start[table + 1] - start[table]));
+		}
+
+		writer.append(key, table, uint64_t(time));
+
+		// rand_r yields 31 random bits
+		if (options.rate)
+			time -= log(1. - rnd::rand_r(&seed) / 2147483648.) * 1e9 / options.rate;
+	}
+
+	if (!writer.close()) {
+		fprintf(stderr, "error: failed to write %s\n", options.trace);
+		return -1;
+	}
+
+	return 0;
+}
+
+// searches of the records of a trace by mode replay, in a search::index or, for traces with table ids, in a
+// search::segmented_index
+template < typename LAYOUT_T >
+struct replay_index
+{
+	const search::index< searchitem_t, LAYOUT_T >& index;
+
+	size_t operator ()(
+		const search::trace_reader< searchitem_t >& trace,
+		const size_t i) const
+	{
+		return index.find(trace.key(i));
+	}
+};
+
+template < typename LAYOUT_T >
+struct replay_segmented
+{
+	const search::segmented_index< searchitem_t, LAYOUT_T >& index;
+
+	size_t operator ()(
+		const search::trace_reader< searchitem_t >& trace,
+		const size_t i) const
+	{
+		return index.find(trace.table(i), trace.key(i));
+	}
+};
+
+// Replay of a trace, unpaced or paced by its arrival times. Paced replay is open-loop: each query is issued at
+// its arrival time, or as soon as the previous one completes if that is later, and its latency counts from its
+// arrival time, so that time spent queued behind slow queries is not left out.
+template < typename SEARCH_T >
+static void replay(
+	const search::trace_reader< searchitem_t >& trace,
+	const SEARCH_T& query,
+	const bool paced,
+	latency_histogram& histogram,
+	uint64_t& max_lag)
+{
+	const size_t count = trace.size();
+	const uint64_t t0 = timer_ns();
+	size_t sink = 0;
+
+	histogram.reset();
+	max_lag = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		uint64_t start = timer_ns();
+
+		if (paced) {
+			const uint64_t due = t0 + trace.time(i);
+
+			// sleep through long gaps, spin through the rest
+			if (start + 1000000 < due) {
+				const uint64_t gap = due - start - 500000;
+				const timespec ts = { time_t(gap / 1000000000ULL), long(gap % 1000000000ULL) };
+				nanosleep(&ts, 0);
+			}
+
+			while (start < due)
+				start = timer_ns();
+
+			if (start - due > max_lag)
+				max_lag = start - due;
+
+			start = due;
+		}
+
+		sink += query(trace, i);
+		histogram.add(timer_ns() - start);
+	}
+
+	found[count * obfuscator] = sink;
+}
+
+// Mode replay: the trace replayed as fast as possible, then, if it has arrival times, paced by them; reports
+// throughput and latency percentiles of both
+template < typename SEARCH_T >
+static int bench_replay(
+	const search::trace_reader< searchitem_t >& trace,
+	const SEARCH_T& query,
+	const size_t size)
+{
+	const size_t count = trace.size();
+	const uint64_t span = count ? trace.time(count - 1) : 0;
+	latency_histogram histogram;
+	uint64_t max_lag;
+
+	printf("replaying " FMT_ULONG " queries, unpaced..\n", count);
+
+	uint64_t t0 = timer_ns();
+	replay(trace, query, false, histogram, max_lag);
+	uint64_t dt = timer_ns() - t0;
+
+	report_searches(dt, count, size);
+	report_latency(histogram);
+
+	if (!trace.has_time())
+		return 0;
+
+	printf("replaying " FMT_ULONG " queries, paced by arrival times over %f s..\n", count, span * 1e-9);
+
+	t0 = timer_ns();
+	replay(trace, query, true, histogram, max_lag);
+	dt = timer_ns() - t0;
+
+	report_searches(dt, count, size);
+	report_latency(histogram);
+	printf("recorded rate: %f queries/s, maximum issue lag: " FMT_ULONG " ns\n", span ? count / (span * 1e-9) : 0., size_t(max_lag));
+
+	return 0;
+}
+
+template < typename LAYOUT_T >
+static int bench_replay(
+	const search::index< searchitem_t, LAYOUT_T >& index,
+	const size_t space_size,
+	const Options& options)
+{
+	search::trace_reader< searchitem_t > trace;
+
+	if (!trace.open(options.trace)) {
+		fprintf(stderr, "error: failed to open %s, or not a trace of keys of the search item type\n", options.trace);
+		return -1;
+	}
+
+	if (!trace.has_table()) {
+		const replay_index< LAYOUT_T > query = { index };
+		return bench_replay(trace, query, index.size());
+	}
+
+	// as many tables as the trace refers to
+	size_t num_table = 0;
+
+	for (size_t i = 0; i < trace.size(); ++i)
+		num_table = max(num_table, size_t(trace.table(i)) + 1);
+
+	aligned_ptr< size_t, alignment > start(num_table + 1);
+
+	segmented_starts(space_size, num_table, start);
+
+	const size_t size = start[num_table];
+
+	if (segmented_max_key < size) {
+		fprintf(stderr, "error: %s %s of a trace of " FMT_ULONG " tables requires a smaller %s\n", arg_mode, mode_name[mode_replay], num_table, arg_space_size);
+		return -1;
+	}
+
+	aligned_ptr< searchitem_t, alignment > src(size);
+
+	for (size_t t = 0; t < num_table; ++t)
+		for (size_t i = start[t]; i < start[t + 1]; ++i)
+			src[i] = searchitem_t(i - start[t]);
+
+	search::segmented_index< searchitem_t, LAYOUT_T > segmented;
+
+	if (!segmented.build(src, start, num_table + 1)) {
+		fprintf(stderr, "error: failed to build segmented_index of size " FMT_ULONG "\n", size);
+		return -1;
+	}
+
+	printf("replaying into " FMT_ULONG " tables of " FMT_ULONG " keys in total..\n", num_table, size);
+
+	const replay_segmented< LAYOUT_T > query = { segmented };
+	return bench_replay(trace, query, size);
+}
+
+// number of page faults of the process so far, minor and major
+static size_t page_faults()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return size_t(usage.ru_minflt + usage.ru_majflt);
+}
+
+// number of major page faults of the process so far, those that read from the backing store
+static size_t major_page_faults()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return size_t(usage.ru_majflt);
+}
+
+// number of pages of a mapping resident in the page cache, or size_t(-1) if unknown
+static size_t cached_pages(
+	void* const map,
+	const size_t bytes)
+{
+	const size_t page = size_t(sysconf(_SC_PAGESIZE));
+	const size_t num_page = (bytes + page - 1) / page;
+	aligned_ptr< unsigned char, alignment > vec(num_page);
+
+	if (vec.is_null() || mincore(map, bytes, vec))
+		return size_t(-1);
+
+	size_t count = 0;
+
+	for (size_t i = 0; i < num_page; ++i)
+		count += vec[i] & 1;
+
+	return count;
+}
+
+static const size_t cold_batch = 1 << 12; // number of searches between evictions in mode cold
+static const size_t cold_max_batch = 64;  // number of batches of mode cold
+
+// streaming over a buffer past the last-level cache, writing a word per cache line, so that the lines of the
+// buffer displace all others, dirty ones included
+static size_t evict(
+	uint8_t* const buffer,
+	const size_t bytes)
+{
+	size_t sum = 0;
+
+	for (size_t i = 0; i < bytes; i += CACHELINE_SIZE)
+		sum += ++buffer[i];
+
+	return sum;
+}
+
+// Background thread of mode cold: it streams over its buffer until told to stop, as a co-located workload
+// competing for the shared caches would.
+struct cache_thrasher
+{
+	uint8_t* buffer;
+	size_t bytes;
+	size_t cpu;
+	size_t laps;
+	bool stop;
+
+	static void* entry(
+		void* arg)
+	{
+		cache_thrasher& thrasher = *reinterpret_cast< cache_thrasher* >(arg);
+
+		if (size_t(-1) != thrasher.cpu)
+			pin_thread(thrasher.cpu);
+
+		size_t sum = 0;
+
+		while (!__atomic_load_n(&thrasher.stop, __ATOMIC_RELAXED)) {
+			sum += evict(thrasher.buffer, thrasher.bytes);
+			++thrasher.laps;
+		}
+
+		found[thrasher.laps * obfuscator] = sum;
+		return 0;
+	}
+};
+
+// searches of mode cold, in batches, through the search routine of the layout over a space of the layout at any
+// address; evicting the caches ahead of every batch if given a buffer; returns the time spent searching
+template < typename LAYOUT_T >
+static uint64_t cold_search(
+	const searchitem_t* const space,
+	const size_t space_size,
+	const size_t num_key,
+	const searchitem_t* const sample,
+	const size_t num_batch,
+	uint8_t* const evict_buffer,
+	const size_t evict_bytes)
+{
+	typedef search::keyed_layout_traits< LAYOUT_T, searchitem_t > traits;
+
+	uint64_t dt = 0;
+
+	for (size_t b = 0; b < num_batch; ++b) {
+		if (evict_buffer)
+			found[b * obfuscator] = evict(evict_buffer, evict_bytes);
+
+		const searchitem_t* const key = sample + b * cold_batch;
+		const uint64_t t0 = timer_ns();
+
+		for (size_t i = 0; i < cold_batch; ++i) {
+			size_t pos;
+			const size_t rank = traits::lower_bound(space, space_size, key[i], pos);
+
+			found[i * obfuscator] = rank < num_key && space[pos] == key[i] ? rank : size_t(-1);
+		}
+
+		dt += timer_ns() - t0;
+	}
+
+	return dt;
+}
+
+// Mode cold: batches of the sample searched in the index warm, as the other modes do, then with the caches
+// evicted ahead of every batch, then beside a thread thrashing the shared caches; then the space copied to a file
+// and searched through a fresh private mapping of it, first unfaulted, with the file dropped from the page cache
+// where the file system allows, every page faulting on its first search, then prefaulted and locked
+template < typename LAYOUT_T >
+static int bench_cold(
+	const search::index< searchitem_t, LAYOUT_T >& index,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options)
+{
+	typedef search::keyed_layout_traits< LAYOUT_T, searchitem_t > traits;
+
+	const size_t size = index.size();
+	const size_t space_size = traits::space_size(size);
+	const size_t num_batch = min(rep / cold_batch, cold_max_batch);
+
+	if (0 == num_batch) {
+		fprintf(stderr, "error: %s %s requires a sample of at least " FMT_ULONG " keys\n", arg_mode, mode_name[mode_cold], cold_batch);
+		return -1;
+	}
+
+	const size_t llc = memory_profile::last_cache_size() ? memory_profile::last_cache_size() : 32 << 20;
+	const size_t evict_bytes = 2 * llc;
+	const size_t thrash_bytes = options.thrash ? options.thrash << 10 : 2 * llc;
+	aligned_ptr< uint8_t, alignment > evict_buffer(evict_bytes);
+
+	memset(evict_buffer, 0, evict_bytes);
+
+	printf("warm, " FMT_ULONG " batches of " FMT_ULONG " searches..\n", num_batch, cold_batch);
+
+	uint64_t dt = cold_search< LAYOUT_T >(index.data(), space_size, size, sample, num_batch, 0, 0);
+	report_searches(dt, num_batch * cold_batch, size);
+
+	printf("caches evicted by " FMT_ULONG " KB ahead of every batch..\n", evict_bytes >> 10);
+
+	dt = cold_search< LAYOUT_T >(index.data(), space_size, size, sample, num_batch, evict_buffer, evict_bytes);
+	report_searches(dt, num_batch * cold_batch, size);
+
+	// the searches on the first CPU, the thrasher on the last CPU of the same node, sharing its last-level cache
+	const topology topo;
+	aligned_ptr< uint8_t, alignment > thrash_buffer(thrash_bytes);
+	cache_thrasher thrasher = { thrash_buffer, thrash_bytes, size_t(-1), 0, false };
+	pthread_t thread;
+
+	memset(thrash_buffer, 0, thrash_bytes);
+
+	bool caller_pinned = false;
+
+#if __linux__ != 0
+	// the affinity of the calling thread, restored past the run, as thread_pool does
+	cpu_set_t caller_affinity;
+
+#endif
+	if (1 < topo.node_cpus(0)) {
+#if __linux__ != 0
+		if (0 == pthread_getaffinity_np(pthread_self(), sizeof(caller_affinity), &caller_affinity))
+			caller_pinned = pin_thread(topo.node_cpu(0, 0));
+
+#endif
+		thrasher.cpu = topo.node_cpu(0, topo.node_cpus(0) - 1);
+	}
+
+	const bool started = 0 == pthread_create(&thread, 0, cache_thrasher::entry, &thrasher);
+
+	if (started) {
+		printf("beside a thread thrashing " FMT_ULONG " KB..\n", thrash_bytes >> 10);
+
+		dt = cold_search< LAYOUT_T >(index.data(), space_size, size, sample, num_batch, 0, 0);
+
+		__atomic_store_n(&thrasher.stop, true, __ATOMIC_RELAXED);
+		pthread_join(thread, 0);
+	}
+
+#if __linux__ != 0
+	if (caller_pinned)
+		pthread_setaffinity_np(pthread_self(), sizeof(caller_affinity), &caller_affinity);
+
+#endif
+	if (!started) {
+		fprintf(stderr, "error: failed to start thrashing thread\n");
+		return -1;
+	}
+
+	report_searches(dt, num_batch * cold_batch, size);
+	printf("thrashing laps: " FMT_ULONG "\n", thrasher.laps);
+
+	// a copy of the space in a file, mapped anew for each of the last two runs
+	const size_t bytes = index.storage_size() * sizeof(searchitem_t);
+	const int fd = open(options.file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+	if (0 > fd) {
+		fprintf(stderr, "error: failed to create %s\n", options.file);
+		return -1;
+	}
+
+	unlink(options.file);
+
+	bool success = true;
+
+	for (size_t done = 0; done < bytes && success; ) {
+		const ssize_t n = write(fd, reinterpret_cast< const uint8_t* >(index.data()) + done, bytes - done);
+		success = 0 < n;
+		done += success ? size_t(n) : 0;
+	}
+
+	if (!success) {
+		fprintf(stderr, "error: failed to write %s\n", options.file);
+		close(fd);
+		return -1;
+	}
+
+	// written pages are dirty and cannot be dropped from the page cache until written back
+	fdatasync(fd);
+
+#if defined(POSIX_FADV_DONTNEED)
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+#endif
+
+	for (size_t run = 0; run < 2; ++run) {
+		void* const map = mmap(0, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (MAP_FAILED == map) {
+			fprintf(stderr, "error: failed to map %s\n", options.file);
+			close(fd);
+			return -1;
+		}
+
+		if (0 == run) {
+			const size_t cached = cached_pages(map, bytes);
+
+			printf("unfaulted mapping of " FMT_ULONG " KB..\n", bytes >> 10);
+
+			if (size_t(-1) != cached)
+				printf("pages in the page cache: " FMT_ULONG " of " FMT_ULONG "%s\n", cached,
+					(bytes + size_t(sysconf(_SC_PAGESIZE)) - 1) / size_t(sysconf(_SC_PAGESIZE)),
+					cached ? ", faulting without reading the file" : "");
+		}
+		else
+		if (0 == mlock(map, bytes))
+			printf("prefaulted and locked mapping of " FMT_ULONG " KB..\n", bytes >> 10);
+		else {
+			// short of the lock limit, prefault only
+			for (size_t i = 0; i < bytes; i += 4096)
+				found[i * obfuscator] = reinterpret_cast< const uint8_t* >(map)[i];
+
+			printf("prefaulted mapping of " FMT_ULONG " KB, failed to lock..\n", bytes >> 10);
+		}
+
+		const size_t faults = page_faults();
+		const size_t major_faults = major_page_faults();
+		dt = cold_search< LAYOUT_T >(reinterpret_cast< const searchitem_t* >(map), space_size, size, sample, num_batch, 0, 0);
+		report_searches(dt, num_batch * cold_batch, size);
+		printf("page faults during the searches: " FMT_ULONG ", major: " FMT_ULONG "\n",
+			page_faults() - faults, major_page_faults() - major_faults);
+
+		munmap(map, bytes);
+	}
+
+	close(fd);
+	return 0;
+}
+
+typedef search::lazy_veb_index< searchitem_t, log2_subsize > lazy_type;
+
+static const size_t lazy_chunk = 1 << 12; // number of keys per chunk of the concurrent searches of mode lazy
+
+// a chunk of the concurrent searches of mode lazy
+struct lazy_search
+{
+	const lazy_type* index;
+	const searchitem_t* key;
+	size_t* result;
+	size_t count;
+
+	static void run(
+		void* arg,
+		size_t chunk,
+		size_t)
+	{
+		const lazy_search& job = *reinterpret_cast< const lazy_search* >(arg);
+		const size_t end = min((chunk + 1) * lazy_chunk, job.count);
+
+		for (size_t i = chunk * lazy_chunk; i < end; ++i)
+			job.result[i] = job.index->find(job.key[i]);
+	}
+};
+
+// Mode lazy: a search::index of the layout selected by alt built in full vs a search::lazy_veb_index built
+// on demand, from the same sorted keys: time to build, to the first search, and memory taken; then the sample
+// searched twice, the first time building the trees it reaches, the second time in them, against the index; last,
+// a fresh lazy index searched by all threads at once, every result checked against the index
+template < typename LAYOUT_T >
+static int bench_lazy(
+	const search::index< searchitem_t, LAYOUT_T >& index,
+	const searchitem_t* const src,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options)
+{
+	typedef search::index< searchitem_t, LAYOUT_T > index_type;
+
+	const size_t size = index.size();
+
+	{
+		index_type eager;
+		const size_t rss = resident_bytes(false);
+		const uint64_t t0 = timer_ns();
+
+		if (!eager.build(src, size)) {
+			fprintf(stderr, "error: failed to build index of size " FMT_ULONG "\n", size);
+			return -1;
+		}
+
+		const uint64_t t1 = timer_ns();
+		found[0] = eager.find(sample[0]);
+		const uint64_t t2 = timer_ns();
+
+		printf("eager build: %f s, to first search: %f s, " FMT_ULONG " KB resident\n",
+			(t1 - t0) * 1e-9, (t2 - t0) * 1e-9, (resident_bytes(false) - rss) >> 10);
+	}
+
+	lazy_type lazy;
+	size_t rss = resident_bytes(false);
+	const uint64_t t0 = timer_ns();
+
+	if (!lazy.build(src, size)) {
+		fprintf(stderr, "error: failed to build lazy_veb_index of size " FMT_ULONG "\n", size);
+		return -1;
+	}
+
+	const uint64_t t1 = timer_ns();
+	found[0] = lazy.find(sample[0]);
+	const uint64_t t2 = timer_ns();
+
+	printf("lazy build:  %f s, to first search: %f s, " FMT_ULONG " KB resident, " FMT_ULONG " of " FMT_ULONG " trees built\n",
+		(t1 - t0) * 1e-9, (t2 - t0) * 1e-9, (resident_bytes(false) - rss) >> 10, lazy.built_trees(), lazy.trees());
+
+	for (size_t pass = 0; pass < 2; ++pass) {
+		printf("lazy searching, %s..\n", pass ? "built" : "building");
+
+		const uint64_t t3 = timer_ns();
+
+		for (size_t i = 0; i < rep; ++i)
+			found[i * obfuscator] = lazy.find(sample[i]);
+
+		report_searches(timer_ns() - t3, rep, size);
+	}
+
+	printf(FMT_ULONG " of " FMT_ULONG " trees built, " FMT_ULONG " KB resident\n",
+		lazy.built_trees(), lazy.trees(), (resident_bytes(false) - rss) >> 10);
+
+	printf("eager searching..\n");
+
+	const uint64_t t4 = timer_ns();
+
+	for (size_t i = 0; i < rep; ++i)
+		found[i * obfuscator] = index.find(sample[i]);
+
+	report_searches(timer_ns() - t4, rep, size);
+
+	thread_pool pool;
+
+	if (!pool.init(options.threads)) {
+		fprintf(stderr, "error: failed to start " FMT_ULONG " threads\n", options.threads);
+		return -1;
+	}
+
+	lazy_type fresh;
+
+	if (!fresh.build(src, size)) {
+		fprintf(stderr, "error: failed to build lazy_veb_index of size " FMT_ULONG "\n", size);
+		return -1;
+	}
+
+	printf("lazy searching, building, " FMT_ULONG " threads..\n", options.threads);
+
+	aligned_ptr< size_t, alignment > result(rep);
+	lazy_search job = { &fresh, sample, result, rep };
+	const uint64_t t5 = timer_ns();
+
+	pool.run(lazy_search::run, &job, (rep + lazy_chunk - 1) / lazy_chunk);
+
+	report_searches(timer_ns() - t5, rep, size);
+
+	for (size_t i = 0; i < rep; ++i)
+		if (result[i] != index.find(sample[i]) || result[i] != lazy.find(sample[i])) {
+			fprintf(stderr, "error: lazy_veb_index FAILURE at " FMT_ULONG "\n", i);
+			return -1;
+		}
+
+	for (size_t i = 0; i < size; ++i)
+		if (fresh.find(src[i]) != i) {
+			fprintf(stderr, "error: lazy_veb_index FAILURE at key %f\n", double(src[i]));
+			return -1;
+		}
+
+	return 0;
+}
+
+static const size_t multi_max_table = 16; // largest number of tables of mode multi
+
+// exact match in a VEB forest, one table at a time: by bsearch_veb_iter where the depth of the forest allows,
+// else by blowerbound_veb
+static size_t search_veb_table(
+	const searchitem_t* const space,
+	const size_t space_size,
+	const searchitem_t key)
+{
+	if (0 == log2_from_pot(space_size) % log2_subsize)
+		return search::bsearch_veb_iter< log2_subsize >(space, space_size, key);
+
+	size_t pos;
+	search::blowerbound_veb< log2_subsize >(space, space_size, key, pos);
+
+	return size_t(-1) != pos && space[pos] == key ? pos : size_t(-1);
+}
+
+// Mode multi: every sample key searched in 2 through 16 VEB indexes of mixed sizes, table i holding one in 1, 16
+// or 256 keys of the space, by the index, at an offset of its own, as the partitions of a join would: one table
+// after another vs all tables at once by bsearch_veb_multi, their descents interleaved
+static int bench_multi(
+	const size_t space_size,
+	const searchitem_t* const sample,
+	const size_t rep)
+{
+	typedef search::layout_veb< log2_subsize > layout_type;
+	typedef search::keyed_layout_traits< layout_type, searchitem_t > traits;
+
+	const size_t size = space_size - 1;
+	search::index< searchitem_t, layout_type > table[multi_max_table];
+	const searchitem_t* space[multi_max_table];
+	size_t table_space_size[multi_max_table];
+	size_t shift[multi_max_table];
+	size_t offset[multi_max_table];
+	aligned_ptr< searchitem_t, alignment > src(size);
+
+	for (size_t i = 0; i < multi_max_table; ++i) {
+		shift[i] = min(log2_subsize * (i % 3), log2_from_pot(space_size) - 1);
+		offset[i] = i / 3 % (size_t(1) << shift[i]);
+
+		size_t len = 0;
+
+		for (size_t k = offset[i]; k < size; k += size_t(1) << shift[i])
+			src[len++] = searchitem_t(k);
+
+		if (!table[i].build(src, len)) {
+			fprintf(stderr, "error: failed to build index of size " FMT_ULONG "\n", len);
+			return -1;
+		}
+
+		space[i] = table[i].data();
+		table_space_size[i] = traits::space_size(len);
+	}
+
+	aligned_ptr< size_t, alignment > seq(rep * multi_max_table);
+	aligned_ptr< size_t, alignment > multi(rep * multi_max_table);
+
+	for (size_t num_table = 2; num_table <= multi_max_table; num_table *= 2) {
+		printf(FMT_ULONG " tables, one after another..\n", num_table);
+
+		const uint64_t t0 = timer_ns();
+
+		for (size_t i = 0; i < rep; ++i)
+			for (size_t t = 0; t < num_table; ++t)
+				seq[i * num_table + t] = search_veb_table(space[t], table_space_size[t], sample[i]);
+
+		const uint64_t dt0 = timer_ns() - t0;
+
+		printf(FMT_ULONG " tables, interleaved..\n", num_table);
+
+		const uint64_t t1 = timer_ns();
+
+		for (size_t i = 0; i < rep; ++i)
+			search::bsearch_veb_multi< log2_subsize >(space, table_space_size, num_table, sample[i], multi + i * num_table);
+
+		const uint64_t dt1 = timer_ns() - t1;
+
+		for (size_t i = 0; i < rep; ++i)
+			for (size_t t = 0; t < num_table; ++t) {
+				const size_t k = size_t(sample[i]);
+				const bool present = k >= offset[t] && 0 == (k - offset[t] & (size_t(1) << shift[t]) - 1);
+				const size_t pos = multi[i * num_table + t];
+
+				if (pos != seq[i * num_table + t] || present != (size_t(-1) != pos) || present && space[t][pos] != sample[i]) {
+					fprintf(stderr, "error: bsearch_veb_multi FAILURE at " FMT_ULONG ", table " FMT_ULONG "\n", i, t);
+					return -1;
+				}
+			}
+
+		printf("one after another: %f keys/s, %f probes/s\ninterleaved:       %f keys/s, %f probes/s\n",
+			rep / (dt0 * 1e-9), rep * num_table / (dt0 * 1e-9), rep / (dt1 * 1e-9), rep * num_table / (dt1 * 1e-9));
+	}
+
+	return 0;
+}
+
+template < typename LAYOUT_T >
+static int bench_layout(
+	const Mode mode,
+	const size_t space_size,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options,
+	const char* const name)
+{
+	const size_t size = space_size - 1; // drop one to even ground with BFS and VEB
+
+	aligned_ptr< searchitem_t, alignment > src(size);
+
+	for (size_t i = 0; i < size; ++i)
+		src[i] = searchitem_t(i);
+
+	search::index< searchitem_t, LAYOUT_T > index;
+
+	if (!index.build(src, size)) {
+		fprintf(stderr, "error: failed to build index_%s of size " FMT_ULONG "\n", name, size);
+		return -1;
+	}
+
+	printf("verifying index_%s consistency, " FMT_ULONG " items of storage..\n", name, index.storage_size());
+
+	if (verify_index(index, name))
+		return -1;
+
+	switch (mode) {
+	case mode_bulk:
+		return bench_bulk(index, static_cast< const searchitem_t* >(src), sample, rep, options);
+	case mode_shard:
+		return bench_shard(index, static_cast< const searchitem_t* >(src), sample, rep, options);
+	case mode_update:
+		return bench_update< LAYOUT_T >(src, size, sample, rep, options);
+	case mode_merge:
+		return bench_merge(index, static_cast< const searchitem_t* >(src), rep);
+	case mode_file:
+		return bench_file(index, static_cast< const searchitem_t* >(src), sample, rep, options);
+	case mode_packed:
+		return bench_packed< LAYOUT_T >(size, sample, rep);
+	case mode_dups:
+		return bench_dups< LAYOUT_T >(size, sample, rep, options);
+	case mode_range:
+		return bench_range(index, static_cast< const searchitem_t* >(src), sample, rep);
+	case mode_segmented:
+		return bench_segmented< LAYOUT_T >(space_size, sample, rep, options);
+	case mode_radix:
+		return bench_radix< LAYOUT_T >(size, options);
+	case mode_filter:
+		return bench_filter(index, static_cast< const searchitem_t* >(src), sample, rep, options);
+	case mode_cache:
+		return bench_cache(index, static_cast< const searchitem_t* >(src), rep);
+	case mode_stream:
+		return bench_stream(index, options);
+	case mode_record:
+		return bench_record(space_size, sample, rep, options);
+	case mode_replay:
+		return bench_replay(index, space_size, options);
+	case mode_cold:
+		return bench_cold(index, sample, rep, options);
+	case mode_weighted:
+		return bench_weighted(index, static_cast< const searchitem_t* >(src), space_size, rep);
+	case mode_lazy:
+		return bench_lazy(index, static_cast< const searchitem_t* >(src), sample, rep, options);
+	case mode_multi:
+		return bench_multi(space_size, sample, rep);
+	default:
+		return bench_index(index, sample, rep);
+	}
+}
+
+static int bench_layout(
+	const size_t alt,
+	const Mode mode,
+	const size_t space_size,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options)
+{
+	switch (alt) {
+	case 0:
+		return bench_layout< search::layout_standard >(mode, space_size, sample, rep, options, "standard");
+	case 1:
+		return bench_layout< search::layout_binned< lead_in > >(mode, space_size, sample, rep, options, "binned");
+	case 2:
+		return bench_layout< search::layout_breadth >(mode, space_size, sample, rep, options, "breadth");
+	case 3:
+	case 4:
+		return bench_layout< search::layout_veb< log2_subsize > >(mode, space_size, sample, rep, options, "veb");
+	case 7:
+		return bench_layout< search::layout_prefix< search::layout_breadth, prefix_levels > >(mode, space_size, sample, rep, options, "prefix_breadth");
+	case 8:
+		return bench_layout< search::layout_prefix< search::layout_veb< log2_subsize >, prefix_levels > >(mode, space_size, sample, rep, options, "prefix_veb");
+	}
+
+	fprintf(stderr, "error: %s %s supports %s 0 through 4, 7 and 8\n", arg_mode, mode_name[mode], arg_alt);
+	return -1;
+}
+
+template < typename SEARCHITEM_T, typename KEY_T >
+struct Search
+{
+	typedef size_t (* search)(const SEARCHITEM_T* const, const size_t, const KEY_T);
+	typedef size_t (* verify)(const size_t, SEARCHITEM_T*);
+};
+
+
+// Helper thread of mode helper: it runs the search routine over the upcoming keys of the sample, so that the
+// lines the main thread is about to need are already in the caches of the core the two threads share. The main
+// thread publishes its progress through a counter; the helper never runs more than lookahead keys ahead of it,
+// and skips ahead when it falls behind.
+struct prefetch_helper
+{
+	Search< searchitem_t, searchitem_t >::search search;
+	const searchitem_t* space;
+	size_t space_size;
+	const searchitem_t* sample;
+	size_t rep;
+	size_t lookahead;
+	size_t cpu;
+	size_t touched; // number of keys searched by the helper
+	size_t sink;
+
+	size_t progress __attribute__ ((aligned(CACHELINE_SIZE))); // position of the main thread in the sample
+
+	static void* entry(
+		void* arg)
+	{
+		prefetch_helper& helper = *reinterpret_cast< prefetch_helper* >(arg);
+
+		if (size_t(-1) != helper.cpu)
+			pin_thread(helper.cpu);
+
+		size_t sink = 0;
+		size_t touched = 0;
+
+		for (size_t i = 0; i < helper.rep; ) {
+			const size_t main_pos = __atomic_load_n(&helper.progress, __ATOMIC_RELAXED);
+
+			if (i < main_pos)
+				i = main_pos;
+
+			if (i >= main_pos + helper.lookahead) {
+#if __x86_64__ || __x86_64 || __amd64__ || __amd64 || __i386__
+				__builtin_ia32_pause();
+#elif __aarch64__ || __arm__
+				asm volatile ("yield");
+#endif
+				continue;
+			}
+
+			sink += helper.search(helper.space, helper.space_size, helper.sample[i++]);
+			++touched;
+		}
+
+		helper.sink = sink;
+		helper.touched = touched;
+		return 0;
+	}
+};
+
+static const size_t helper_progress_period = 8; // number of keys between progress updates by the main thread
+
+static int bench_helper(
+	const Search< searchitem_t, searchitem_t >::search search,
+	const searchitem_t* const space,
+	const size_t space_size,
+	const searchitem_t* const sample,
+	const size_t rep,
+	const Options& options)
+{
+	const topology topo;
+
+	// run the main thread on a CPU with an SMT sibling, if there is one
+	size_t cpu = topo.node_cpu(0, 0);
+	size_t sibling = size_t(-1);
+
+	for (size_t i = 0; i < topo.node_cpus(0) && size_t(-1) == sibling; ++i) {
+		cpu = topo.node_cpu(0, i);
+		sibling = topology::smt_sibling(cpu);
+	}
+
+	if (size_t(-1) == sibling) {
+		cpu = topo.node_cpu(0, 0);
+
+		if (1 < topo.cpus()) {
+			sibling = topo.node_cpu(topo.nodes() - 1, topo.node_cpus(topo.nodes() - 1) - 1);
+			printf("no SMT siblings found; helper thread on cpu " FMT_ULONG ", sharing only the outer caches\n", sibling);
+		}
+		else
+			printf("no SMT siblings found; helper thread unpinned\n");
+	}
+	else
+		printf("main thread on cpu " FMT_ULONG ", helper thread on its SMT sibling cpu " FMT_ULONG "\n", cpu, sibling);
+
+	pin_thread(cpu);
+
+	printf("searching without helper..\n");
+
+	const uint64_t t0 = timer_ns();
+
+	for (size_t i = 0; i < rep; ++i)
+		found[i * obfuscator] = search(space, space_size, sample[i]);
+
+	report_searches(timer_ns() - t0, rep, space_size);
+
+	prefetch_helper helper;
+	helper.search = search;
+	helper.space = space;
+	helper.space_size = space_size;
+	helper.sample = sample;
+	helper.rep = rep;
+	helper.lookahead = options.lookahead;
+	helper.cpu = sibling;
+	helper.touched = 0;
+	helper.sink = 0;
+	helper.progress = 0;
+
+	pthread_t thread;
+
+	if (pthread_create(&thread, 0, prefetch_helper::entry, &helper)) {
+		fprintf(stderr, "error: failed to start helper thread\n");
+		return -1;
+	}
+
+	printf("searching with helper, lookahead " FMT_ULONG "..\n", options.lookahead);
+
+	const uint64_t t1 = timer_ns();
+
+	for (size_t i = 0; i < rep; ++i) {
+		found[i * obfuscator] = search(space, space_size, sample[i]);
+
+		if (0 == i % helper_progress_period)
+			__atomic_store_n(&helper.progress, i, __ATOMIC_RELAXED);
+	}
+
+	const uint64_t dt1 = timer_ns() - t1;
+
+	// release a helper waiting for progress
+	__atomic_store_n(&helper.progress, rep, __ATOMIC_RELAXED);
+	pthread_join(thread, 0);
+
+	report_searches(dt1, rep, space_size);
+	printf("keys searched ahead by helper: " FMT_ULONG " (%.1f%%)\n", helper.touched, 100.0 * helper.touched / rep);
+
+	return 0;
+}
+
+static int parse_cli(
+	int argc,
+	char** argv,
+	size_t& rep,
+	size_t& space_size,
+	size_t& alt,
+	Mode& mode,
+	Options& options,
+	Search< searchitem_t, searchitem_t >::search& search,
+	Search< searchitem_t, searchitem_t >::verify& verify)
+{
+	bool rep_done = false;
+
+	for (int i = 1; i < argc; ++i) {
+		// use a double for all numeric arguments, so the user can specify big numbers in scientific notation
+		double input;
+
+		if (0 == strcmp(argv[i], arg_space_size)) {
+			const unsigned max_size = 1U << 24;
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 0 < input) {
+				if (input > max_size) {
+					fprintf(stderr, "error: %s should not exceed %u\n",
+						arg_space_size, max_size);
+					return -1;
+				}
+				if (0 != (unsigned(input) & unsigned(input) - 1)) {
+					fprintf(stderr, "error: %s should be a power of two\n",
+						arg_space_size);
+					return -1;
+				}
+
+				space_size = size_t(input);
+				continue;
+			}
+		}
+
+		if (0 == strcmp(argv[i], arg_alt)) {
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 0 <= input && 11 >= input) {
+				alt = size_t(input);
+				switch (alt) {
+				case 1:
+					search = bsearch_binned;
+					verify = verify_bsearch_binned;
+					break;
+				case 2:
+					search = bsearch_breadth;
+					verify = verify_bsearch_breadth;
+					break;
+				case 3:
+					search = bsearch_veb;
+					verify = verify_bsearch_veb;
+					break;
+				case 4:
+					search = bsearch_veb_iter;
+					verify = verify_bsearch_veb_iter;
+					break;
+				case 5:
+					search = lsearch_standard;
+					verify = verify_lsearch_standard;
+					break;
+				case 6:
+					search = lsearch_binned;
+					verify = verify_lsearch_binned;
+					break;
+				case 9:
+					search = bsearch_stl;
+					verify = verify_bsearch_stl;
+					break;
+				case 10:
+					search = search_map;
+					verify = verify_search_map;
+					break;
+				case 11:
+					search = search_hash;
+					verify = verify_search_hash;
+					break;
+				}
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_threads)) {
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 1 <= input) {
+				options.threads = size_t(input);
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_numa)) {
+			if (argc > i + 1) {
+				size_t j = 0;
+
+				while (j < numa_count && strcmp(argv[i + 1], numa_name[j]))
+					++j;
+
+				if (j < numa_count) {
+					options.numa = Numa(j);
+					++i;
+					continue;
+				}
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_lookahead)) {
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 1 <= input) {
+				options.lookahead = size_t(input);
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_updates)) {
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 0 <= input) {
+				options.updates = size_t(input);
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_delta)) {
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 1 <= input) {
+				options.delta = size_t(input);
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_file)) {
+			if (argc > i + 1) {
+				options.file = argv[++i];
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_input)) {
+			if (argc > i + 1) {
+				options.input = argv[++i];
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_output)) {
+			if (argc > i + 1) {
+				options.output = argv[++i];
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_trace)) {
+			if (argc > i + 1) {
+				options.trace = argv[++i];
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_rate)) {
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 0 <= input) {
+				options.rate = size_t(input);
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_calibrate)) {
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 0 <= input) {
+				options.calibrate = size_t(input);
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_thrash)) {
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 0 <= input) {
+				options.thrash = size_t(input);
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_depth)) {
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 1 <= input) {
+				options.depth = size_t(input);
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_dups)) {
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 1 <= input) {
+				options.dups = size_t(input);
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_bits)) {
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 1 <= input) {
+				options.bits = size_t(input);
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_tables)) {
+			if (argc > i + 1 && 1 == sscanf(argv[++i], "%lf", &input) && 1 <= input && input <= double(uint32_t(-1))) {
+				options.tables = size_t(input);
+				continue;
+			}
+			rep_done = true;
+		}
+
+		if (0 == strcmp(argv[i], arg_mode)) {
+			if (argc > i + 1) {
+				size_t j = 0;
+
+				while (j < mode_count && strcmp(argv[i + 1], mode_name[j]))
+					++j;
+
+				if (j < mode_count) {
+					mode = Mode(j);
+					++i;
+					continue;
+				}
+			}
+			rep_done = true;
+		}
+
+		if (!rep_done && 1 == sscanf(argv[i], "%lf", &input) && 0 < input) {
+			rep = size_t(input);
+			rep_done = true;
+			continue;
+		}
+
+		fprintf(stderr, "usage: %s [%s <unsigned>] [%s <unsigned>] [%s <name>] [%s <unsigned>] [%s <name>] [%s <unsigned>] [%s <unsigned>] [%s <unsigned>] [%s <path>] [%s <unsigned>] [%s <unsigned>] [%s <unsigned>] [%s <unsigned>] [%s <path>] [%s <path>] [%s <path>] [%s <unsigned>] [%s <unsigned>] [%s <unsigned>] [<sample_size>]\n"
+			"\talt 0: standard binary search (default)\n"
+			"\talt 1: binned binary search\n"
+			"\talt 2: breadth-first layout binary search\n"
+			"\talt 3: Van Emde Boas (VEB) layout binary search, recursive version\n"
+			"\talt 4: VEB layout binary search, iterative version\n"
+			"\talt 5: standard linear search\n"
+			"\talt 6: binned linear search\n"
+			"\talt 7: breadth-first layout with the top levels held as 16-bit key prefixes, modes other than search and helper\n"
+			"\talt 8: VEB layout with the top levels held as 16-bit key prefixes, modes other than search and helper\n"
+			"\talt 9: std::lower_bound over the sorted array, modes search and helper\n"
+			"\talt 10: std::map of the keys to their positions, modes search and helper\n"
+			"\talt 11: open-addressing hash index of the keys with SIMD tag match, modes search and helper\n"
+			"\tmode search: search via the standalone routine of the alt (default)\n"
+			"\tmode index: search via a search::index of the layout of the alt (0 - 4, 7, 8)\n"
+			"\tmode bulk: multi-threaded bulk search via a search::index, thread count doubling up to threads\n"
+			"\tmode shard: thread-per-core sharded search vs bulk search in a shared search::index, at threads\n"
+			"\tmode helper: search of the alt with vs without an SMT helper thread prefetching up to lookahead keys ahead\n"
+			"\tmode update: lookups by threads in an updatable index with vs without updates at updates per second,\n"
+			"\t             rebuilt in the background every delta updates\n"
+			"\tmode merge: merge of a sorted batch of 5%% new keys into a search::index vs a rebuild from scratch\n"
+			"\tmode file: cold lookups in file of 4KB pages of keys, via mmap vs pread, by up to depth threads\n"
+			"\tmode packed: lookups in a frame-of-reference compressed index of 64-bit ids vs VEB search over the raw ids\n"
+			"\tmode rank: search of the alt (1 - 4) for layout positions vs for sorted ranks, by mapping and directly\n"
+			"\tmode dups: equal_range in an index of keys of dups occurrences each vs find then scan\n"
+			"\tmode range: in-order scans of ranges of 10 and 10000 keys via index cursors vs a plain sorted array\n"
+			"\tmode segmented: lookups in sorted tables of up to space_size keys, in one arena vs one allocation per table\n"
+			"\tmode radix: build of an index from unsorted keys by parallel radix sort at threads vs sort then build\n"
+			"\tmode filter: exact-match search with vs without a Bloom filter of bits per key, across miss ratios\n"
+			"\tmode cache: exact-match search of Zipf-distributed keys with vs without a hot-key cache, across skews\n"
+			"\tmode stream: exact-match search of the binary keys of input, positions written to output as binary size_t\n"
+			"\tmode record: write the sample to trace as queries of tables tables, arriving at rate queries/s (0: untimed)\n"
+			"\tmode replay: replay trace as fast as possible, then paced by its arrival times, reporting latency percentiles\n"
+			"\tmode cold: search warm vs with caches evicted per batch vs beside a thread thrashing thrash KB,\n"
+			"\t           then in an unfaulted mapping vs a prefaulted, locked one\n"
+			"\tmode weighted: exact-match search of Zipf-distributed keys in a tree weighted by a query profile vs the index,\n"
+			"\t               with levels and blocks touched per search, expected vs measured, across skews\n"
+			"\tmode lazy: startup and search of a VEB index built on demand vs an index built in full, then by threads\n"
+			"\tmode multi: exact-match search of every key in 2 to 16 VEB tables of mixed sizes, sequential vs interleaved\n"
+			"\tnuma off: unpinned threads, space first-touched by the main thread (default)\n"
+			"\tnuma first_touch: threads pinned across nodes, space first-touched by the main thread\n"
+			"\tnuma interleave: threads pinned across nodes, space pages interleaved across nodes\n"
+			"\tnuma replicate: threads pinned across nodes, each searching a replica local to its node\n",
+			argv[0], arg_space_size, arg_alt, arg_mode, arg_threads, arg_numa, arg_lookahead, arg_updates, arg_delta, arg_file, arg_depth, arg_dups, arg_tables, arg_bits, arg_input, arg_output, arg_trace, arg_rate, arg_calibrate, arg_thrash);
+
+		return -1;
+	}
+
+	return 0;
+}
+
+
+template < typename SEARCH_T >
+static void time_searches(
+	const SEARCH_T search,
+	size_t (* const map)(const size_t, const size_t),
+	const searchitem_t* const space,
+	const size_t space_size,
+	const searchitem_t* const sample,
+	const size_t rep)
+{
+	const uint64_t t0 = timer_ns();
+
+	if (map)
+		for (size_t i = 0; i < rep; ++i)
+			found[i * obfuscator] = map(space_size, search(space, space_size, sample[i]));
+	else
+		for (size_t i = 0; i < rep; ++i)
+			found[i * obfuscator] = search(space, space_size, sample[i]);
+
+	report_searches(timer_ns() - t0, rep, space_size);
+}
+
+// Mode rank: the search routine of the alt returning layout positions, the same mapped to sorted ranks by the
+// inverse position map of the layout, and the rank-returning version of the routine.
+static int bench_rank(
+	const size_t alt,
+	const Search< searchitem_t, searchitem_t >::search search,
+	const searchitem_t* const space,
+	const size_t space_size,
+	const searchitem_t* const sample,
+	const size_t rep)
+{
+	Search< searchitem_t, searchitem_t >::search search_rank;
+	size_t (* map)(const size_t, const size_t);
+
+	switch (alt) {
+	case 1:
+		search_rank = bsearch_binned_rank;
+		map = rank_from_binned;
+		break;
+	case 2:
+		search_rank = bsearch_breadth_rank;
+		map = rank_from_breadth;
+		break;
+	default:
+		search_rank = bsearch_veb_iter_rank;
+		map = rank_from_veb;
+		break;
+	}
+
+	// the binned space size is its item count, the tree ones are one past it
+	const size_t num_item = 1 == alt ? space_size : space_size - 1;
+
+	printf("verifying sorted ranks..\n");
+
+	for (size_t i = 0; i < num_item; ++i) {
+		const searchitem_t key = searchitem_t(i);
+
+		if (map(space_size, search(space, space_size, key)) != i || search_rank(space, space_size, key) != i) {
+			fprintf(stderr, "error: sorted rank FAILURE at " FMT_ULONG "\n", i);
+			return -1;
+		}
+	}
+
+	printf("searching for layout positions..\n");
+	time_searches(search, 0, space, space_size, sample, rep);
+
+	printf("searching for layout positions, mapped to sorted ranks..\n");
+	time_searches(search, map, space, space_size, sample, rep);
+
+	printf("searching for sorted ranks..\n");
+	time_searches(search_rank, 0, space, space_size, sample, rep);
+
+	return 0;
+}
+
+
+int main(
+	int argc,
+	char** argv)
+{
+	size_t rep = 1e7;
+	size_t space_size = 2e3;
+	size_t alt = 0;
+	Mode mode = mode_search;
+	Options options;
+
+	options.threads = size_t(sysconf(_SC_NPROCESSORS_ONLN));
+	options.numa = numa_off;
+	options.lookahead = 64;
+	options.updates = 100000;
+	options.delta = 4096;
+	options.file = "test_bsearch.pages";
+	options.depth = 32;
+	options.dups = 256;
+	options.tables = 4096;
+	options.bits = 10;
+	options.input = "-";
+	options.output = "-";
+	options.trace = "test_bsearch.trace";
+	options.rate = 1000000;
+	options.calibrate = 0;
+	options.thrash = 0;
+
+	Search< searchitem_t, searchitem_t >::search search = bsearch_standard;
+	Search< searchitem_t, searchitem_t >::verify verify = verify_bsearch_standard;
+
+	const int cli_res = parse_cli(
+		argc, argv,
+		rep, space_size, alt, mode, options, search, verify);
+
+	if (0 != cli_res)
+		return cli_res;
+
+	// positions of mode stream written to stdout keep it to themselves; all reports go to stderr instead
+	if (mode_stream == mode && 0 == strcmp(options.output, "-")) {
+		stream_stdout = dup(STDOUT_FILENO);
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+		setvbuf(stdout, 0, _IOLBF, 0);
+	}
+
+	if (options.calibrate) {
+		printf("calibrating memory..\n");
+		memory.calibrate();
+		memory.print();
+	}
+
+	printf("generating search space..\n");
+
+	const uint64_t s0 = timer_ns();
+
+	// generate 'search sample' - a random array of type searchitem_t and size rep
+	const compile_assert< 0 == (rnd::rand_max & rnd::rand_max + 1LL) > assert_rand_max_is_pot_minus_one;
+	const aligned_ptr< searchitem_t, alignment > sample(rep);
+
+	const unsigned log2_rand = bitcount(rnd::rand_max);
+	assert(0 == (space_size & space_size - 1));
+	const unsigned log2_space = log2_from_pot(space_size);
+	assert(log2_rand >= log2_space);
+	unsigned seed = 42;
+
+	for (size_t i = 0; i < rep; ++i)
+		sample[i] = searchitem_t(rnd::rand_r(&seed) >> log2_rand - log2_space);
+
+	if (mode_search != mode && mode_helper != mode && mode_rank != mode)
+		return bench_layout(alt, mode, space_size, sample, rep, options);
+
+	if (mode_rank == mode && (1 > alt || 4 < alt)) {
+		fprintf(stderr, "error: %s %s supports %s 1 through 4\n", arg_mode, mode_name[mode], arg_alt);
+		return -1;
+	}
+
+	if (6 < alt && 9 > alt) {
+		fprintf(stderr, "error: %s %s supports %s 0 through 6 and 9 through 11\n", arg_mode, mode_name[mode], arg_alt);
+		return -1;
+	}
+
+	// generate 'search space' - a sorted array from 0 to space_size - 1
+	aligned_ptr< searchitem_t, alignment > space;
+
+	if (search == bsearch_binned ||
+		search == lsearch_binned) {
+
+		if (64 > space_size) {
+			fprintf(stderr, "error: binned %s requires a minimum space size of 64\n", search == bsearch_binned ? "bsearch" : "lsearch");
+			return -1;
+		}
+
+		space_size -= 1; // drop one to even ground with BFS and VEB
+		space.malloc(space_size + lead_in);
+
+		printf("verifying binned %s consistency for " FMT_ULONG " bins..\n", search == bsearch_binned ? "bsearch" : "lsearch", lead_in);
 	}
 	else
 	if (search == bsearch_breadth) {
@@ -736,7 +4029,16 @@ int main(
 		space_size -= 1; // drop one to even ground with BFS and VEB
 		space.malloc(space_size);
 
-		printf("verifying standard %s consistency..\n", search == lsearch_standard ? "lsearch" : "bsearch");
+		if (search == bsearch_stl)
+			printf("verifying std::lower_bound consistency..\n");
+		else
+		if (search == search_map)
+			printf("verifying std::map consistency..\n");
+		else
+		if (search == search_hash)
+			printf("verifying hash index consistency..\n");
+		else
+			printf("verifying standard %s consistency..\n", search == lsearch_standard ? "lsearch" : "bsearch");
 	}
 
 #if 0
@@ -751,6 +4053,13 @@ int main(
 	if (verify(space_size, space))
 		return -1;
 
+	if (search == search_map)
+		printf("std::map of " FMT_ULONG " nodes, about " FMT_ULONG " bytes\n",
+			reference_map.size(), reference_map.size() * (sizeof(std::map< searchitem_t, size_t >::value_type) + 4 * sizeof(void*)));
+	else
+	if (search == search_hash)
+		printf("hash index of " FMT_ULONG " keys, " FMT_ULONG " bytes\n", reference_hash.size(), reference_hash.storage_bytes());
+
 	const uint64_t ds = timer_ns() - s0;
 
 	if (ds) {
@@ -758,6 +4067,12 @@ int main(
 		printf("elapsed time: %f\n", sec);
 	}
 
+	if (mode_helper == mode)
+		return bench_helper(search, space, space_size, sample, rep, options);
+
+	if (mode_rank == mode)
+		return bench_rank(alt, search, space, space_size, sample, rep);
+
 	printf("searching..\n");
 
 	const uint64_t t0 = timer_ns();
@@ -767,11 +4082,7 @@ int main(
 
 	const uint64_t dt = timer_ns() - t0;
 
-	if (dt) {
-		const double sec = double(dt) * 1e-9;
-		printf("elapsed time: %f (" FMT_ULONG " repetitions over a space of " FMT_ULONG ")\n", sec, rep, space_size);
-		printf("average searches/s: %f\n", rep / sec);
-	}
+	report_searches(dt, rep, space_size);
 
 	return 0;
 }
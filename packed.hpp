@@ -0,0 +1,237 @@
+#ifndef packed_H__
+#define packed_H__
+
+#include <stdint.h>
+
+#include "aligned_ptr.hpp"
+#include "bsearch.hpp"
+
+namespace search {
+
+// A sorted set of unsigned integer keys compressed by frame of reference: the keys are split into blocks of
+// block_size keys, each stored as its least key, the base, and the offsets of its keys from the base, bit-packed
+// at the width of the greatest offset. The last key of each block, the fence, is kept uncompressed in a
+// search::index of the layout, which picks the block of a key; the block is then binary-searched in place, so a
+// lookup unpacks only log2(block_size) + 1 offsets. Dense key sets thus take a byte or two per key.
+template < typename KEY_T, typename LAYOUT_T >
+class packed_index
+{
+public:
+	typedef KEY_T key_type;
+	typedef LAYOUT_T layout_type;
+
+	static const size_t npos = size_t(-1);
+	static const size_t block_size = 128; // power of two
+
+private:
+	struct block {
+		KEY_T base;
+		uint32_t offset; // word offset of the packed offsets of the block
+		uint32_t width;  // bit width of the packed offsets of the block
+	};
+
+	index< KEY_T, LAYOUT_T > fence;
+	aligned_ptr< block, CACHELINE_SIZE > desc;
+	aligned_ptr< uint64_t, CACHELINE_SIZE > word;
+	size_t num_key;
+	size_t num_block;
+	size_t num_word;
+
+	packed_index(
+		const packed_index& src); // undefined
+
+	packed_index& operator =(
+		const packed_index& src); // undefined
+
+	static size_t bit_width(
+		const uint64_t x)
+	{
+		return x ? 64 - __builtin_clzll(x) : 0;
+	}
+
+	// offset at position i of a block at the specified width; two words of slack past the packed words keep both
+	// words read in bounds, for blocks of zero width too
+	static uint64_t unpack(
+		const uint64_t* const src,
+		const size_t width,
+		const uint64_t mask,
+		const size_t i)
+	{
+		const size_t bit = i * width;
+		const size_t shift = bit & 63;
+		const uint64_t* const w = src + (bit >> 6);
+
+		// the high word is shifted in two steps, lest a shift of zero turn into an undefined shift by 64
+		return (w[0] >> shift | w[1] << 63 - shift << 1) & mask;
+	}
+
+	// position of the lower bound of the key in a block, or block_size if all keys of the block are less
+	size_t search_block(
+		const size_t b,
+		const KEY_T key,
+		bool& found) const
+	{
+		const block& d = desc[b];
+		const uint64_t* const src = word + d.offset;
+		const uint64_t mask = d.width ? ~uint64_t(0) >> 64 - d.width : 0;
+
+		// keys less than the base have their lower bound at the start of the block
+		const uint64_t delta = key < d.base ? 0 : uint64_t(key - d.base);
+		size_t pos = 0;
+
+		for (size_t half = block_size / 2; half; half >>= 1)
+			pos += unpack(src, d.width, mask, pos + half - 1) < delta ? half : 0;
+
+		const uint64_t last = unpack(src, d.width, mask, pos);
+
+		found = !(key < d.base) && last == delta;
+		return pos + (last < delta ? 1 : 0);
+	}
+
+	size_t search(
+		const size_t b,
+		const KEY_T key,
+		const bool lower_bound) const
+	{
+		if (num_block <= b)
+			return lower_bound ? num_key : npos;
+
+		bool found;
+		const size_t rank = b * block_size + search_block(b, key, found);
+
+		if (lower_bound)
+			return rank < num_key ? rank : num_key;
+
+		return found && rank < num_key ? rank : npos;
+	}
+
+public:
+	packed_index()
+	: num_key(0)
+	, num_block(0)
+	, num_word(0)
+	{
+	}
+
+	// build from an array of keys sorted in ascending order; return 0 on failure, leaving the index intact
+	size_t build(
+		const KEY_T* const src,
+		const size_t len_src)
+	{
+		if (0 == len_src)
+			return 0;
+
+		const size_t new_num_block = (len_src + block_size - 1) / block_size;
+		aligned_ptr< block, CACHELINE_SIZE > new_desc(new_num_block);
+		aligned_ptr< KEY_T, CACHELINE_SIZE > fences(new_num_block);
+		size_t new_num_word = 0;
+
+		if (new_desc.is_null() || fences.is_null())
+			return 0;
+
+		// the last block is padded by repeating its last key, as pad_for_tree does
+		for (size_t b = 0; b < new_num_block; ++b) {
+			const size_t last = b * block_size + block_size - 1 < len_src ? b * block_size + block_size - 1 : len_src - 1;
+			const size_t width = bit_width(uint64_t(src[last] - src[b * block_size]));
+
+			new_desc[b].base = src[b * block_size];
+			new_desc[b].offset = uint32_t(new_num_word);
+			new_desc[b].width = uint32_t(width);
+			fences[b] = src[last];
+			new_num_word += (block_size * width + 63) / 64;
+
+			if (uint32_t(-1) < new_num_word)
+				return 0;
+		}
+
+		aligned_ptr< uint64_t, CACHELINE_SIZE > new_word(new_num_word + 2);
+
+		if (new_word.is_null())
+			return 0;
+
+		for (size_t i = 0; i < new_num_word + 2; ++i)
+			new_word[i] = 0;
+
+		for (size_t b = 0; b < new_num_block; ++b) {
+			const block& d = new_desc[b];
+			uint64_t* const dst = new_word + d.offset;
+
+			for (size_t i = 0; i < block_size && d.width; ++i) {
+				const size_t k = b * block_size + i < len_src ? b * block_size + i : len_src - 1;
+				const uint64_t delta = uint64_t(src[k] - d.base);
+				const size_t bit = i * d.width;
+				const size_t shift = bit & 63;
+
+				dst[bit >> 6] |= delta << shift;
+
+				if (shift + d.width > 64)
+					dst[(bit >> 6) + 1] |= delta >> 64 - shift;
+			}
+		}
+
+		if (!fence.build(fences, new_num_block))
+			return 0;
+
+		desc.move(new_desc);
+		word.move(new_word);
+		num_key = len_src;
+		num_block = new_num_block;
+		num_word = new_num_word;
+
+		return 1;
+	}
+
+	// number of keys in the index
+	size_t size() const
+	{
+		return num_key;
+	}
+
+	// number of bytes taken by the index: packed offsets, block descriptors and fence index
+	size_t storage_bytes() const
+	{
+		return num_key ? (num_word + 2) * sizeof(uint64_t) + num_block * sizeof(block) + fence.storage_size() * sizeof(KEY_T) : 0;
+	}
+
+	// searches as by search::index
+
+	size_t find(
+		const KEY_T key) const
+	{
+		return search(fence.lower_bound(key), key, false);
+	}
+
+	size_t lower_bound(
+		const KEY_T key) const
+	{
+		return search(fence.lower_bound(key), key, true);
+	}
+
+	// batch versions of the above; the blocks of the keys are picked by the batch searches of the fence index
+
+	void find(
+		const KEY_T* const key,
+		const size_t count,
+		size_t* const result) const
+	{
+		fence.lower_bound(key, count, result);
+
+		for (size_t i = 0; i < count; ++i)
+			result[i] = search(result[i], key[i], false);
+	}
+
+	void lower_bound(
+		const KEY_T* const key,
+		const size_t count,
+		size_t* const result) const
+	{
+		fence.lower_bound(key, count, result);
+
+		for (size_t i = 0; i < count; ++i)
+			result[i] = search(result[i], key[i], true);
+	}
+};
+
+} // namespace search
+
+#endif // packed_H__
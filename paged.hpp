@@ -0,0 +1,423 @@
+#ifndef paged_H__
+#define paged_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "aligned_ptr.hpp"
+#include "bsearch.hpp"
+#include "thread_pool.hpp"
+
+namespace search {
+
+enum paged_backend {
+	paged_mmap,  // pages read by faults on a read-only mapping of the file
+	paged_pread  // pages read by explicit reads into per-thread buffers
+};
+
+// A sorted set of keys stored in a file, for sets that exceed memory. The keys are split into 4KB pages, each a
+// breadth-first tree of one page worth of keys less one; the last key of each page, the fence, is kept in memory
+// in a search::index of the layout, so that each lookup costs a single page read. File layout: one page of
+// header, the fences padded to a page boundary, then the pages of keys.
+template < typename KEY_T, typename LAYOUT_T >
+class paged_index
+{
+public:
+	typedef KEY_T key_type;
+	typedef LAYOUT_T layout_type;
+
+	static const size_t npos = size_t(-1);
+	static const size_t page_size = 4096;
+	static const size_t page_slots = page_size / sizeof(KEY_T); // power of two
+	static const size_t page_keys = page_slots - 1;
+
+private:
+	static const size_t chunk_size = 16; // number of keys per unit of work of a batch search
+
+	struct header {
+		char magic[8];
+		uint64_t key_size;
+		uint64_t num_key;
+		uint64_t num_page;
+		uint64_t leaf_offset; // file offset of the first page of keys
+	};
+
+	struct job {
+		paged_index* self;
+		const KEY_T* key;
+		size_t count;
+		size_t* result;
+		bool lower_bound;
+	};
+
+	index< KEY_T, LAYOUT_T > fence;
+	int fd;
+	paged_backend backend;
+	const uint8_t* map;
+	size_t map_size;
+	size_t num_key;
+	size_t num_page;
+	uint64_t leaf_offset;
+	size_t num_read; // number of page reads by the pread backend
+	aligned_ptr< uint8_t, page_size > buffer; // one page per worker, plus one for the scalar searches
+
+	paged_index(
+		const paged_index& src); // undefined
+
+	paged_index& operator =(
+		const paged_index& src); // undefined
+
+	static const char* magic()
+	{
+		return "bsrchpg1";
+	}
+
+	static size_t min_size(
+		const size_t a,
+		const size_t b)
+	{
+		return a < b ? a : b;
+	}
+
+	static bool write_all(
+		const int fd,
+		const void* const src,
+		const size_t size)
+	{
+		for (size_t done = 0; done < size; ) {
+			const ssize_t n = ::write(fd, reinterpret_cast< const uint8_t* >(src) + done, size - done);
+
+			if (0 >= n)
+				return false;
+
+			done += size_t(n);
+		}
+
+		return true;
+	}
+
+	static bool read_all(
+		const int fd,
+		void* const dst,
+		const size_t size,
+		const uint64_t offset)
+	{
+		for (size_t done = 0; done < size; ) {
+			const ssize_t n = ::pread(fd, reinterpret_cast< uint8_t* >(dst) + done, size - done, off_t(offset + done));
+
+			if (0 >= n)
+				return false;
+
+			done += size_t(n);
+		}
+
+		return true;
+	}
+
+	// page holding the lower bound of the key, or num_page if all keys are less than the key
+	size_t page_of(
+		const KEY_T key) const
+	{
+		return fence.lower_bound(key);
+	}
+
+	// fetch a page; the buffer is used by the pread backend only
+	const KEY_T* fetch(
+		const size_t page,
+		uint8_t* const buf)
+	{
+		const uint64_t offset = leaf_offset + uint64_t(page) * page_size;
+
+		if (paged_mmap == backend)
+			return reinterpret_cast< const KEY_T* >(map + offset);
+
+		__atomic_fetch_add(&num_read, 1, __ATOMIC_RELAXED);
+
+		if (!read_all(fd, buf, page_size, offset))
+			return 0;
+
+		return reinterpret_cast< const KEY_T* >(buf);
+	}
+
+	size_t search(
+		const KEY_T key,
+		const size_t page,
+		const KEY_T* const space,
+		const bool lower_bound) const
+	{
+		if (num_page == page)
+			return lower_bound ? num_key : npos;
+
+		if (0 == space)
+			return npos;
+
+		size_t pos;
+		const size_t rank = page * page_keys + blowerbound_breadth(space, page_slots, key, pos);
+
+		return lower_bound || space[pos] == key ? rank : npos;
+	}
+
+	static void run(
+		void* const arg,
+		const size_t chunk,
+		const size_t worker)
+	{
+		const job& j = *reinterpret_cast< const job* >(arg);
+		paged_index& self = *j.self;
+		const size_t begin = chunk * chunk_size;
+		const size_t end = begin + chunk_size < j.count ? begin + chunk_size : j.count;
+		size_t page[chunk_size];
+
+		for (size_t i = begin; i < end; ++i)
+			page[i - begin] = self.page_of(j.key[i]);
+
+#if defined(MADV_WILLNEED)
+		// have the reads of all pages of the chunk in flight before faulting on the first one
+		if (paged_mmap == self.backend)
+			for (size_t i = begin; i < end; ++i)
+				if (self.num_page != page[i - begin])
+					madvise(const_cast< uint8_t* >(self.map) + self.leaf_offset + uint64_t(page[i - begin]) * page_size,
+						page_size, MADV_WILLNEED);
+
+#endif
+		uint8_t* const buf = self.buffer + (worker + 1) * page_size;
+
+		for (size_t i = begin; i < end; ++i) {
+			const size_t p = page[i - begin];
+			const KEY_T* const space = self.num_page == p ? 0 : self.fetch(p, buf);
+
+			j.result[i] = self.search(j.key[i], p, space, j.lower_bound);
+		}
+	}
+
+	void batch(
+		thread_pool& pool,
+		const KEY_T* const key,
+		const size_t count,
+		size_t* const result,
+		const bool lower_bound)
+	{
+		// one page buffer per worker past the scalar one
+		buffer.malloc((pool.size() + 1) * page_size);
+
+		job j = { this, key, count, result, lower_bound };
+		pool.run(run, &j, (count + chunk_size - 1) / chunk_size);
+	}
+
+public:
+	paged_index()
+	: fd(-1)
+	, backend(paged_mmap)
+	, map(0)
+	, map_size(0)
+	, num_key(0)
+	, num_page(0)
+	, leaf_offset(0)
+	, num_read(0)
+	{
+	}
+
+	~paged_index()
+	{
+		close();
+	}
+
+	// write a file from an array of keys sorted in ascending order; return 0 on failure
+	static size_t write_file(
+		const char* const path,
+		const KEY_T* const src,
+		const size_t len_src)
+	{
+		if (0 == len_src)
+			return 0;
+
+		const int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		if (0 > fd)
+			return 0;
+
+		const size_t num_page = (len_src + page_keys - 1) / page_keys;
+		const size_t fence_size = (num_page * sizeof(KEY_T) + page_size - 1) / page_size * page_size;
+		aligned_ptr< uint8_t, page_size > buf(page_size > fence_size ? page_size : fence_size);
+		aligned_ptr< KEY_T, page_size > padded(page_slots);
+
+		header h;
+		memset(buf, 0, page_size);
+		memcpy(h.magic, magic(), sizeof(h.magic));
+		h.key_size = sizeof(KEY_T);
+		h.num_key = len_src;
+		h.num_page = num_page;
+		h.leaf_offset = page_size + fence_size;
+		memcpy(buf, &h, sizeof(h));
+
+		bool success = write_all(fd, buf, page_size);
+
+		memset(buf, 0, fence_size);
+
+		for (size_t i = 0; i < num_page; ++i)
+			reinterpret_cast< KEY_T* >(static_cast< uint8_t* >(buf))[i] = src[min_size(i * page_keys + page_keys, len_src) - 1];
+
+		success = success && write_all(fd, buf, fence_size);
+
+		for (size_t i = 0; i < num_page && success; ++i) {
+			const size_t begin = i * page_keys;
+			const size_t end = min_size(begin + page_keys, len_src);
+			KEY_T* const page = reinterpret_cast< KEY_T* >(static_cast< uint8_t* >(buf));
+
+			// pad the last page by repeating its last key, as pad_for_tree does
+			for (size_t k = begin; k < begin + page_keys; ++k)
+				padded[k - begin] = src[k < end ? k : end - 1];
+
+			page[page_keys] = KEY_T();
+			prepare_for_breadth_search(page, page_slots, static_cast< const KEY_T* >(padded), page_slots);
+			success = write_all(fd, page, page_size);
+		}
+
+		success = success && 0 == fsync(fd);
+		::close(fd);
+
+		return success;
+	}
+
+	// open a file written by write_file with the specified backend, optionally evicting the file from the page
+	// cache first, so that searches start cold; the fences are read into memory and locked there where possible;
+	// return 0 on failure
+	size_t open(
+		const char* const path,
+		const paged_backend new_backend,
+		const bool cold)
+	{
+		close();
+
+		fd = ::open(path, O_RDONLY);
+
+		if (0 > fd)
+			return 0;
+
+		header h;
+
+		if (!read_all(fd, &h, sizeof(h), 0) || memcmp(h.magic, magic(), sizeof(h.magic)) ||
+			sizeof(KEY_T) != h.key_size || 0 == h.num_page) {
+			close();
+			return 0;
+		}
+
+		aligned_ptr< KEY_T, page_size > fences(h.num_page);
+
+		if (!read_all(fd, fences, h.num_page * sizeof(KEY_T), page_size) || !fence.build(fences, h.num_page)) {
+			close();
+			return 0;
+		}
+
+		mlock(fence.data(), fence.storage_size() * sizeof(KEY_T));
+
+#if defined(POSIX_FADV_DONTNEED)
+		if (cold)
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+#endif
+		backend = new_backend;
+		num_key = h.num_key;
+		num_page = h.num_page;
+		leaf_offset = h.leaf_offset;
+		num_read = 0;
+		buffer.malloc(page_size);
+
+		if (paged_mmap == backend) {
+			map_size = size_t(leaf_offset + uint64_t(num_page) * page_size);
+			void* const p = mmap(0, map_size, PROT_READ, MAP_SHARED, fd, 0);
+
+			if (MAP_FAILED == p) {
+				close();
+				return 0;
+			}
+
+			map = reinterpret_cast< const uint8_t* >(p);
+
+			// lookups touch one page each; readahead would only waste I/O
+			madvise(p, map_size, MADV_RANDOM);
+		}
+
+		return 1;
+	}
+
+	void close()
+	{
+		if (map) {
+			munmap(const_cast< uint8_t* >(map), map_size);
+			map = 0;
+			map_size = 0;
+		}
+
+		if (0 <= fd) {
+			::close(fd);
+			fd = -1;
+		}
+
+		num_key = 0;
+		num_page = 0;
+	}
+
+	// number of keys in the index
+	size_t size() const
+	{
+		return num_key;
+	}
+
+	// number of pages of keys in the file
+	size_t pages() const
+	{
+		return num_page;
+	}
+
+	// number of page reads issued by the pread backend since open
+	size_t reads() const
+	{
+		return __atomic_load_n(&num_read, __ATOMIC_RELAXED);
+	}
+
+	// searches as by search::index, npos also standing for I/O errors; the scalar versions are not thread-safe
+	// with the pread backend
+
+	size_t find(
+		const KEY_T key)
+	{
+		const size_t page = page_of(key);
+		return search(key, page, num_page == page ? 0 : fetch(page, buffer), false);
+	}
+
+	size_t lower_bound(
+		const KEY_T key)
+	{
+		const size_t page = page_of(key);
+		return search(key, page, num_page == page ? 0 : fetch(page, buffer), true);
+	}
+
+	// batch versions of the above, spreading the keys over the workers of a pool, so that the page reads of up to
+	// one chunk of keys per worker are in flight at a time
+
+	void find(
+		thread_pool& pool,
+		const KEY_T* const key,
+		const size_t count,
+		size_t* const result)
+	{
+		batch(pool, key, count, result, false);
+	}
+
+	void lower_bound(
+		thread_pool& pool,
+		const KEY_T* const key,
+		const size_t count,
+		size_t* const result)
+	{
+		batch(pool, key, count, result, true);
+	}
+};
+
+} // namespace search
+
+#endif // paged_H__
@@ -0,0 +1,445 @@
+#ifndef radix_H__
+#define radix_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "aligned_ptr.hpp"
+#include "bsearch.hpp"
+#include "thread_pool.hpp"
+
+namespace search {
+
+// Order-preserving maps of keys to unsigned integers of the same width, for radix sorting: unsigned keys map to
+// themselves, signed keys get their sign bit flipped, and floating-point keys get their sign bit flipped if clear
+// or all their bits flipped if set, which puts negatives below positives in reverse order of magnitude. Negative
+// zero maps as positive zero, so the two dedup as one; NaNs sort past the infinities of their sign.
+template < typename KEY_T >
+struct radix_key;
+
+template <>
+struct radix_key< uint32_t >
+{
+	typedef uint32_t bits_type;
+
+	static bits_type encode(
+		const uint32_t key)
+	{
+		return key;
+	}
+
+	static uint32_t decode(
+		const bits_type bits)
+	{
+		return bits;
+	}
+};
+
+template <>
+struct radix_key< uint64_t >
+{
+	typedef uint64_t bits_type;
+
+	static bits_type encode(
+		const uint64_t key)
+	{
+		return key;
+	}
+
+	static uint64_t decode(
+		const bits_type bits)
+	{
+		return bits;
+	}
+};
+
+template <>
+struct radix_key< int32_t >
+{
+	typedef uint32_t bits_type;
+
+	static bits_type encode(
+		const int32_t key)
+	{
+		return bits_type(key) ^ bits_type(1) << 31;
+	}
+
+	static int32_t decode(
+		const bits_type bits)
+	{
+		return int32_t(bits ^ bits_type(1) << 31);
+	}
+};
+
+template <>
+struct radix_key< int64_t >
+{
+	typedef uint64_t bits_type;
+
+	static bits_type encode(
+		const int64_t key)
+	{
+		return bits_type(key) ^ bits_type(1) << 63;
+	}
+
+	static int64_t decode(
+		const bits_type bits)
+	{
+		return int64_t(bits ^ bits_type(1) << 63);
+	}
+};
+
+template <>
+struct radix_key< float >
+{
+	typedef uint32_t bits_type;
+
+	static bits_type encode(
+		const float key)
+	{
+		const bits_type sign = bits_type(1) << 31;
+		bits_type bits;
+		memcpy(&bits, &key, sizeof(bits));
+
+		if (sign == bits)
+			bits = 0;
+
+		return bits ^ (bits & sign ? ~bits_type(0) : sign);
+	}
+
+	static float decode(
+		const bits_type bits)
+	{
+		const bits_type sign = bits_type(1) << 31;
+		const bits_type raw = bits ^ (bits & sign ? sign : ~bits_type(0));
+		float key;
+		memcpy(&key, &raw, sizeof(key));
+
+		return key;
+	}
+};
+
+template <>
+struct radix_key< double >
+{
+	typedef uint64_t bits_type;
+
+	static bits_type encode(
+		const double key)
+	{
+		const bits_type sign = bits_type(1) << 63;
+		bits_type bits;
+		memcpy(&bits, &key, sizeof(bits));
+
+		if (sign == bits)
+			bits = 0;
+
+		return bits ^ (bits & sign ? ~bits_type(0) : sign);
+	}
+
+	static double decode(
+		const bits_type bits)
+	{
+		const bits_type sign = bits_type(1) << 63;
+		const bits_type raw = bits ^ (bits & sign ? sign : ~bits_type(0));
+		double key;
+		memcpy(&key, &raw, sizeof(key));
+
+		return key;
+	}
+};
+
+static const size_t radix_bits = 11; // number of key bits per pass of the radix sort
+static const size_t radix_size = size_t(1) << radix_bits;
+static const size_t radix_chunk_min = 1 << 16; // minimum number of keys per unit of work of a radix pass
+
+// State of a radix build: an LSD radix sort of the encoded keys, each pass a parallel count of the digits over
+// fixed chunks of the input of the pass, then a parallel scatter of every chunk from its own offsets per digit.
+// Passes whose keys all share the digit are skipped. The input of the final pass is sorted by all digits but the
+// last, so the keys of every digit arrive in sorted order, and equal keys back to back: the final count tells the
+// distinct keys, duplicates across chunk boundaries included, which fixes the count of keys of the index, and
+// the final scatter writes only the distinct keys, straight into the layout, through its position_map.
+template < typename INDEX_T >
+struct radix_job
+{
+	typedef typename INDEX_T::key_type key_type;
+	typedef keyed_layout_traits< typename INDEX_T::layout_type, key_type > traits;
+	typedef radix_key< key_type > codec;
+	typedef typename codec::bits_type bits_type;
+
+	static const size_t num_pass = (sizeof(bits_type) * 8 + radix_bits - 1) / radix_bits;
+
+	const key_type* key; // unsorted input, read until the first pass that scatters
+	const bits_type* src; // input of the current pass, once past the first pass that scatters
+	bits_type* dst;       // output of the current pass, but for the final one
+	key_type* space;      // laid-out storage, output of the final pass
+	const typename traits::position_map* map;
+	size_t len;
+	size_t num_chunk;
+	size_t shift; // of the digit of the current pass
+
+	// per chunk and digit: count of keys, or of distinct keys in the final pass, then scatter offset
+	aligned_ptr< size_t, CACHELINE_SIZE > count;
+	// per chunk and digit of the final pass: first and last key, and whether the first equals the last key of the
+	// digit in the preceding chunks; the scatter reuses these as the last key written and whether there is one
+	aligned_ptr< bits_type, CACHELINE_SIZE > head;
+	aligned_ptr< bits_type, CACHELINE_SIZE > tail;
+	aligned_ptr< uint8_t, CACHELINE_SIZE > dup;
+
+	bits_type item(
+		const size_t i) const
+	{
+		return src ? src[i] : codec::encode(key[i]);
+	}
+
+	size_t digit(
+		const bits_type bits) const
+	{
+		return size_t(bits >> shift) & radix_size - 1;
+	}
+
+	size_t begin(
+		const size_t chunk) const
+	{
+		return chunk * len / num_chunk;
+	}
+
+	static void count_digits(
+		void* const arg,
+		const size_t chunk,
+		const size_t)
+	{
+		const radix_job& job = *reinterpret_cast< const radix_job* >(arg);
+		size_t* const c = job.count + chunk * radix_size;
+		const size_t end = job.begin(chunk + 1);
+
+		memset(c, 0, radix_size * sizeof(c[0]));
+
+		for (size_t i = job.begin(chunk); i < end; ++i)
+			++c[job.digit(job.item(i))];
+	}
+
+	static void scatter(
+		void* const arg,
+		const size_t chunk,
+		const size_t)
+	{
+		const radix_job& job = *reinterpret_cast< const radix_job* >(arg);
+		size_t* const offset = job.count + chunk * radix_size;
+		const size_t end = job.begin(chunk + 1);
+
+		for (size_t i = job.begin(chunk); i < end; ++i) {
+			const bits_type bits = job.item(i);
+			job.dst[offset[job.digit(bits)]++] = bits;
+		}
+	}
+
+	static void count_distinct(
+		void* const arg,
+		const size_t chunk,
+		const size_t)
+	{
+		const radix_job& job = *reinterpret_cast< const radix_job* >(arg);
+		size_t* const c = job.count + chunk * radix_size;
+		bits_type* const h = job.head + chunk * radix_size;
+		bits_type* const t = job.tail + chunk * radix_size;
+		const size_t end = job.begin(chunk + 1);
+
+		memset(c, 0, radix_size * sizeof(c[0]));
+
+		for (size_t i = job.begin(chunk); i < end; ++i) {
+			const bits_type bits = job.item(i);
+			const size_t d = job.digit(bits);
+
+			if (0 == c[d]) {
+				h[d] = bits;
+				t[d] = bits;
+				c[d] = 1;
+			}
+			else if (t[d] != bits) {
+				t[d] = bits;
+				++c[d];
+			}
+		}
+	}
+
+	static void scatter_distinct(
+		void* const arg,
+		const size_t chunk,
+		const size_t)
+	{
+		const radix_job& job = *reinterpret_cast< const radix_job* >(arg);
+		const typename traits::position_map& map = *job.map;
+		size_t* const offset = job.count + chunk * radix_size;
+		bits_type* const last = job.tail + chunk * radix_size;
+		uint8_t* const written = job.dup + chunk * radix_size;
+		const size_t end = job.begin(chunk + 1);
+
+		// a first key equal to the last one of the digit in the preceding chunks counts as written already
+		memcpy(last, job.head + chunk * radix_size, radix_size * sizeof(last[0]));
+
+		for (size_t i = job.begin(chunk); i < end; ++i) {
+			const bits_type bits = job.item(i);
+			const size_t d = job.digit(bits);
+
+			if (written[d] && last[d] == bits)
+				continue;
+
+			job.space[map(offset[d]++)] = codec::decode(bits);
+			last[d] = bits;
+			written[d] = 1;
+		}
+	}
+
+	// turn the counts of the digits into scatter offsets, digit-major, chunk-minor; return false if all keys share
+	// the digit, making the pass an identity
+	bool plan()
+	{
+		for (size_t d = 0; d < radix_size; ++d) {
+			size_t total = 0;
+
+			for (size_t c = 0; c < num_chunk; ++c)
+				total += count[c * radix_size + d];
+
+			if (len == total)
+				return false;
+		}
+
+		size_t base = 0;
+
+		for (size_t d = 0; d < radix_size; ++d)
+			for (size_t c = 0; c < num_chunk; ++c) {
+				const size_t n = count[c * radix_size + d];
+
+				count[c * radix_size + d] = base;
+				base += n;
+			}
+
+		return true;
+	}
+
+	// as above, for the distinct counts of the final pass, discounting first keys equal to the last key of the
+	// digit in the preceding chunks; return the count of distinct keys
+	size_t plan_distinct()
+	{
+		size_t base = 0;
+
+		for (size_t d = 0; d < radix_size; ++d) {
+			bool have_last = false;
+			bits_type last = 0;
+
+			for (size_t c = 0; c < num_chunk; ++c) {
+				const size_t i = c * radix_size + d;
+				const size_t n = count[i];
+
+				dup[i] = n && have_last && head[i] == last;
+				count[i] = base;
+				base += n - dup[i];
+
+				if (n) {
+					last = tail[i];
+					have_last = true;
+				}
+			}
+		}
+
+		return base;
+	}
+};
+
+// Build an index from an array of keys in any order, duplicates allowed, using all workers of the pool; the index
+// gets the distinct keys. No sorted copy of the keys is made: the sort takes two buffers of encoded keys, one of
+// which is freed ahead of the allocation of the laid-out storage. Return 0 on failure, leaving the index intact.
+template < typename INDEX_T >
+inline size_t radix_build(
+	thread_pool& pool,
+	INDEX_T& index,
+	const typename INDEX_T::key_type* const key,
+	const size_t len)
+{
+	typedef radix_job< INDEX_T > job_type;
+	typedef typename job_type::traits traits;
+	typedef typename job_type::bits_type bits_type;
+
+	if (0 == len)
+		return 0;
+
+	const size_t max_chunk = pool.size() * 4;
+	const size_t num_chunk = len / radix_chunk_min < max_chunk ? len / radix_chunk_min + 1 : max_chunk;
+
+	job_type job;
+	job.key = key;
+	job.src = 0;
+	job.dst = 0;
+	job.space = 0;
+	job.map = 0;
+	job.len = len;
+	job.num_chunk = num_chunk;
+	job.count.malloc(num_chunk * radix_size);
+
+	if (job.count.is_null())
+		return 0;
+
+	aligned_ptr< bits_type, CACHELINE_SIZE > buffer[2];
+	size_t next = 0;
+
+	for (size_t pass = 0; pass < job_type::num_pass - 1; ++pass) {
+		job.shift = pass * radix_bits;
+		pool.run(job_type::count_digits, &job, num_chunk);
+
+		if (!job.plan())
+			continue;
+
+		if (buffer[next].is_null())
+			buffer[next].malloc(len);
+
+		if (buffer[next].is_null())
+			return 0;
+
+		job.dst = buffer[next];
+		pool.run(job_type::scatter, &job, num_chunk);
+		job.src = job.dst;
+		next ^= 1;
+	}
+
+	// the buffer not holding the input of the final pass, if any, is of no further use
+	buffer[next].free();
+
+	job.shift = (job_type::num_pass - 1) * radix_bits;
+	job.head.malloc(num_chunk * radix_size);
+	job.tail.malloc(num_chunk * radix_size);
+	job.dup.malloc(num_chunk * radix_size);
+
+	if (job.head.is_null() || job.tail.is_null() || job.dup.is_null())
+		return 0;
+
+	pool.run(job_type::count_distinct, &job, num_chunk);
+
+	const size_t num_key = job.plan_distinct();
+	const size_t space_size = traits::space_size(num_key);
+	const typename traits::position_map map(space_size);
+	aligned_ptr< typename INDEX_T::key_type, INDEX_T::alignment > storage(traits::storage_size(space_size));
+
+	if (storage.is_null())
+		return 0;
+
+	job.space = storage;
+	job.map = &map;
+	pool.run(job_type::scatter_distinct, &job, num_chunk);
+
+	// pad to a complete tree by repeating the last key, as pad_for_tree does
+	const typename INDEX_T::key_type last = job.space[map(num_key - 1)];
+
+	for (size_t r = num_key; r < traits::item_count(space_size); ++r)
+		job.space[map(r)] = last;
+
+	// the scatter wrote the item slots only; finish() initialises the others, so that the storage is that of a
+	// build from sorted keys
+	traits::finish(job.space, space_size);
+
+	return index.adopt(storage, num_key);
+}
+
+} // namespace search
+
+#endif // radix_H__
@@ -0,0 +1,219 @@
+#ifndef segmented_H__
+#define segmented_H__
+
+#include <stdint.h>
+
+#include "aligned_ptr.hpp"
+#include "bsearch.hpp"
+
+namespace search {
+
+// Many small sorted sets of keys, the tables, searched by table id. All tables share one arena: each is laid out
+// as by a search::index of the layout, from the cache line past the end of the previous one, and is described by
+// an entry of a table of offsets. No table has an allocation of its own, so a build takes two allocations however
+// many the tables, and tables adjacent by id are adjacent in memory. Keys within a table need not be unique.
+template < typename KEY_T, typename LAYOUT_T >
+class segmented_index
+{
+public:
+	typedef KEY_T key_type;
+	typedef LAYOUT_T layout_type;
+
+	static const size_t npos = size_t(-1);
+
+private:
+	typedef keyed_layout_traits< LAYOUT_T, KEY_T > traits;
+
+	static const size_t prefetch_distance = 8; // number of keys whose tables are prefetched ahead by the batch searches
+	static const size_t line_items = CACHELINE_SIZE / sizeof(KEY_T) ? CACHELINE_SIZE / sizeof(KEY_T) : 1;
+
+	struct table {
+		size_t offset;       // item offset of the laid-out table in the arena
+		uint32_t num_key;
+		uint32_t space_size; // as taken by the search routines of the layout
+	};
+
+	aligned_ptr< table, CACHELINE_SIZE > desc;
+	aligned_ptr< KEY_T, CACHELINE_SIZE > arena;
+	size_t num_table;
+	size_t num_key;
+	size_t arena_size;
+
+	segmented_index(
+		const segmented_index& src); // undefined
+
+	segmented_index& operator =(
+		const segmented_index& src); // undefined
+
+	size_t search(
+		const size_t t,
+		const KEY_T key,
+		const bool lower_bound) const
+	{
+		const table& d = desc[t];
+
+		if (0 == d.num_key)
+			return lower_bound ? 0 : npos;
+
+		const KEY_T* const space = arena + d.offset;
+		size_t pos;
+		const size_t rank = traits::lower_bound(space, d.space_size, key, pos);
+
+		if (lower_bound)
+			return rank < d.num_key ? rank : d.num_key;
+
+		return rank < d.num_key && space[pos] == key ? rank : npos;
+	}
+
+	// the descriptors of the tables of the keys two prefetch distances ahead are prefetched, then the first lines of
+	// the tables of the keys one distance ahead, which hold the roots or, for the prefix layouts, the quantizers
+	void batch(
+		const uint32_t* const table_id,
+		const KEY_T* const key,
+		const size_t count,
+		size_t* const result,
+		const bool lower_bound) const
+	{
+		const table* const d = desc;
+		const KEY_T* const space = arena;
+
+		for (size_t i = 0; i < count; ++i) {
+			if (i + 2 * prefetch_distance < count)
+				__builtin_prefetch(d + table_id[i + 2 * prefetch_distance]);
+
+			if (i + prefetch_distance < count)
+				__builtin_prefetch(space + d[table_id[i + prefetch_distance]].offset);
+
+			result[i] = search(table_id[i], key[i], lower_bound);
+		}
+	}
+
+public:
+	segmented_index()
+	: num_table(0)
+	, num_key(0)
+	, arena_size(0)
+	{
+	}
+
+	// build from the keys of all tables, stored table after table, each table sorted in ascending order; table t
+	// takes the keys from start[t] up to start[t + 1], of len_start = table count + 1 starts; tables may be empty;
+	// return 0 on failure, leaving the index intact
+	size_t build(
+		const KEY_T* const src,
+		const size_t* const start,
+		const size_t len_start)
+	{
+		if (2 > len_start)
+			return 0;
+
+		const size_t new_num_table = len_start - 1;
+		aligned_ptr< table, CACHELINE_SIZE > new_desc(new_num_table);
+		size_t new_arena_size = 0;
+
+		if (new_desc.is_null())
+			return 0;
+
+		for (size_t t = 0; t < new_num_table; ++t) {
+			const size_t len = start[t + 1] - start[t];
+
+			if (start[t + 1] < start[t] || uint32_t(-1) / 2 < len)
+				return 0;
+
+			const size_t space_size = len ? traits::space_size(len) : 0;
+
+			new_desc[t].offset = new_arena_size;
+			new_desc[t].num_key = uint32_t(len);
+			new_desc[t].space_size = uint32_t(space_size);
+
+			if (len)
+				new_arena_size += (traits::storage_size(space_size) + line_items - 1) / line_items * line_items;
+		}
+
+		aligned_ptr< KEY_T, CACHELINE_SIZE > new_arena(new_arena_size);
+
+		if (new_arena_size && new_arena.is_null())
+			return 0;
+
+		for (size_t t = 0; t < new_num_table; ++t) {
+			const table& d = new_desc[t];
+
+			if (d.num_key && !traits::build(new_arena + d.offset, traits::storage_size(d.space_size), src + start[t], d.num_key, d.space_size))
+				return 0;
+		}
+
+		desc.move(new_desc);
+		arena.move(new_arena);
+		num_table = new_num_table;
+		num_key = start[new_num_table] - start[0];
+		arena_size = new_arena_size;
+
+		return 1;
+	}
+
+	// number of tables in the index
+	size_t tables() const
+	{
+		return num_table;
+	}
+
+	// number of keys in all tables
+	size_t size() const
+	{
+		return num_key;
+	}
+
+	// number of keys in the specified table
+	size_t size(
+		const size_t t) const
+	{
+		return desc[t].num_key;
+	}
+
+	// number of bytes taken by the index: arena and table of offsets
+	size_t storage_bytes() const
+	{
+		return arena_size * sizeof(KEY_T) + num_table * sizeof(table);
+	}
+
+	// searches as by search::index of the specified table
+
+	size_t find(
+		const size_t t,
+		const KEY_T key) const
+	{
+		return search(t, key, false);
+	}
+
+	size_t lower_bound(
+		const size_t t,
+		const KEY_T key) const
+	{
+		return search(t, key, true);
+	}
+
+	// batch versions of the above, over pairs of table id and key; results are written to the array of the same
+	// count as the pairs
+
+	void find(
+		const uint32_t* const table_id,
+		const KEY_T* const key,
+		const size_t count,
+		size_t* const result) const
+	{
+		batch(table_id, key, count, result, false);
+	}
+
+	void lower_bound(
+		const uint32_t* const table_id,
+		const KEY_T* const key,
+		const size_t count,
+		size_t* const result) const
+	{
+		batch(table_id, key, count, result, true);
+	}
+};
+
+} // namespace search
+
+#endif // segmented_H__
@@ -0,0 +1,460 @@
+#ifndef shard_H__
+#define shard_H__
+
+#include <sched.h>
+#include <pthread.h>
+
+#include "aligned_ptr.hpp"
+#include "spsc_ring.hpp"
+#include "topology.hpp"
+
+namespace search {
+
+// A sorted set of keys range-partitioned into shards, one per thread, each thread owning, building and being the
+// only one to search its shard, so that a shard stays in the caches of its core. Each thread also acts as a
+// producer: it routes a slice of the queries of a search to the owning shards through a grid of single-producer
+// single-consumer rings, one per pair of threads, and serves the queries routed to its own shard in batches,
+// scattering the results to the positions of their queries. Threads persist between searches.
+template < typename INDEX_T >
+class sharded_index
+{
+public:
+	typedef typename INDEX_T::key_type key_type;
+
+	static const size_t npos = size_t(-1);
+
+private:
+	struct query {
+		key_type key;
+		size_t pos;
+	};
+
+	static const size_t ring_capacity = 512; // number of queries per ring
+	static const size_t transfer_size = 64;  // number of queries per ring transfer and per batch search
+	static const size_t route_size = 256;    // number of own queries routed between rounds of serving
+
+	typedef spsc_ring< query, ring_capacity > ring;
+
+	struct shard {
+		INDEX_T index;
+		sharded_index* engine;
+		size_t id;
+		size_t cpu;          // CPU the thread is pinned to, or size_t(-1)
+		size_t rank_offset;  // sorted position of the first key of the shard
+		const key_type* src; // keys of the shard, valid during build only
+		size_t size;
+		size_t built;
+		aligned_ptr< query, CACHELINE_SIZE > outbox; // per destination shard, transfer_size queries each
+		aligned_ptr< size_t, CACHELINE_SIZE > outbox_count;
+		pthread_t thread;
+	};
+
+	shard* shards;
+	size_t num_shard;
+	size_t num_key;
+	aligned_ptr< key_type, CACHELINE_SIZE > splitter; // first key of each shard but the first one
+	aligned_ptr< ring, CACHELINE_SIZE > rings;        // ring from shard i to shard j at i * num_shard + j
+
+	// current search
+	const key_type* job_key;
+	size_t job_count;
+	size_t* job_result;
+	bool job_lower_bound;
+	size_t job_done __attribute__ ((aligned(CACHELINE_SIZE))); // number of queries with results
+
+	size_t num_built;
+	size_t num_active;
+	uint64_t generation;
+	bool quit;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond_start;
+	pthread_cond_t cond_done;
+
+	sharded_index(
+		const sharded_index& src); // undefined
+
+	sharded_index& operator =(
+		const sharded_index& src); // undefined
+
+	ring& link(
+		const size_t from,
+		const size_t to)
+	{
+		return rings[from * num_shard + to];
+	}
+
+	// shard owning a key: the count of shards whose first key is not greater than the key
+	size_t route(
+		const key_type key) const
+	{
+		const key_type* base = splitter;
+		size_t len = num_shard - 1;
+
+		while (len > 1) {
+			const size_t half = len / 2;
+			const key_type k = base[half];
+
+			base = k <= key ? base + half : base;
+			len -= half;
+		}
+
+		if (0 == len)
+			return 0;
+
+		const key_type k = *base;
+		return size_t(base - static_cast< const key_type* >(splitter)) + (k <= key ? 1 : 0);
+	}
+
+	void process(
+		const size_t id,
+		const query* const q,
+		const size_t count)
+	{
+		if (0 == count)
+			return;
+
+		const shard& self = shards[id];
+		key_type key[transfer_size];
+		size_t result[transfer_size];
+
+		for (size_t i = 0; i < count; ++i)
+			key[i] = q[i].key;
+
+		if (job_lower_bound) {
+			self.index.lower_bound(key, count, result);
+
+			for (size_t i = 0; i < count; ++i)
+				job_result[q[i].pos] = result[i] + self.rank_offset;
+		}
+		else {
+			self.index.find(key, count, result);
+
+			for (size_t i = 0; i < count; ++i)
+				job_result[q[i].pos] = npos == result[i] ? npos : result[i] + self.rank_offset;
+		}
+
+		__atomic_fetch_add(&job_done, count, __ATOMIC_RELEASE);
+	}
+
+	// serve all queries routed to the shard so far; return the number of queries served
+	size_t drain(
+		const size_t id)
+	{
+		query q[transfer_size];
+		size_t served = 0;
+
+		for (size_t from = 0; from < num_shard; ++from) {
+			if (from == id)
+				continue;
+
+			ring& r = link(from, id);
+			size_t n;
+
+			while (0 != (n = r.pop(q, transfer_size))) {
+				process(id, q, n);
+				served += n;
+			}
+		}
+
+		return served;
+	}
+
+	// hand the outbox to a destination shard, serving the own shard whenever the destination ring is full, so
+	// that shards waiting on each other's rings make progress
+	void flush(
+		const size_t id,
+		const size_t to)
+	{
+		shard& self = shards[id];
+		const query* const out = self.outbox + to * transfer_size;
+		const size_t count = self.outbox_count[to];
+
+		if (to == id)
+			process(id, out, count);
+		else
+			for (size_t pushed = 0; pushed < count; ) {
+				pushed += link(id, to).push(out + pushed, count - pushed);
+
+				if (pushed < count && 0 == drain(id))
+					sched_yield();
+			}
+
+		self.outbox_count[to] = 0;
+	}
+
+	void serve(
+		const size_t id)
+	{
+		shard& self = shards[id];
+		const size_t end = job_count * (id + 1) / num_shard;
+		size_t cursor = job_count * id / num_shard;
+
+		for (;;) {
+			const size_t route_end = cursor + route_size < end ? cursor + route_size : end;
+
+			for (; cursor < route_end; ++cursor) {
+				const size_t to = route(job_key[cursor]);
+				const query q = { job_key[cursor], cursor };
+
+				self.outbox[to * transfer_size + self.outbox_count[to]] = q;
+
+				if (transfer_size == ++self.outbox_count[to])
+					flush(id, to);
+			}
+
+			if (cursor == end)
+				for (size_t to = 0; to < num_shard; ++to)
+					if (self.outbox_count[to])
+						flush(id, to);
+
+			const size_t served = drain(id);
+
+			if (cursor == end) {
+				if (__atomic_load_n(&job_done, __ATOMIC_ACQUIRE) == job_count)
+					return;
+
+				if (0 == served)
+					sched_yield();
+			}
+		}
+	}
+
+	static void* shard_main(
+		void* arg)
+	{
+		shard& self = *reinterpret_cast< shard* >(arg);
+		sharded_index& engine = *self.engine;
+		uint64_t seen = 0;
+
+		if (size_t(-1) != self.cpu)
+			pin_thread(self.cpu);
+
+		// build on the thread that searches the shard, so that it is first-touched on its node
+		self.built = self.index.build(self.src, self.size);
+		self.outbox.malloc(engine.num_shard * transfer_size);
+		self.outbox_count.malloc(engine.num_shard);
+
+		for (size_t i = 0; i < engine.num_shard; ++i)
+			self.outbox_count[i] = 0;
+
+		pthread_mutex_lock(&engine.mutex);
+
+		if (engine.num_shard == ++engine.num_built)
+			pthread_cond_signal(&engine.cond_done);
+
+		pthread_mutex_unlock(&engine.mutex);
+
+		for (;;) {
+			pthread_mutex_lock(&engine.mutex);
+
+			while (seen == engine.generation && !engine.quit)
+				pthread_cond_wait(&engine.cond_start, &engine.mutex);
+
+			seen = engine.generation;
+			const bool quit = engine.quit;
+
+			pthread_mutex_unlock(&engine.mutex);
+
+			if (quit)
+				return 0;
+
+			engine.serve(self.id);
+
+			pthread_mutex_lock(&engine.mutex);
+
+			if (0 == --engine.num_active)
+				pthread_cond_signal(&engine.cond_done);
+
+			pthread_mutex_unlock(&engine.mutex);
+		}
+	}
+
+	void run(
+		const key_type* const key,
+		const size_t count,
+		size_t* const result,
+		const bool lower_bound)
+	{
+		assert(0 != num_shard);
+
+		pthread_mutex_lock(&mutex);
+		job_key = key;
+		job_count = count;
+		job_result = result;
+		job_lower_bound = lower_bound;
+		job_done = 0;
+		num_active = num_shard;
+		++generation;
+		pthread_cond_broadcast(&cond_start);
+
+		while (num_active)
+			pthread_cond_wait(&cond_done, &mutex);
+
+		pthread_mutex_unlock(&mutex);
+	}
+
+public:
+	sharded_index()
+	: shards(0)
+	, num_shard(0)
+	, num_key(0)
+	, job_key(0)
+	, job_count(0)
+	, job_result(0)
+	, job_lower_bound(false)
+	, job_done(0)
+	, num_built(0)
+	, num_active(0)
+	, generation(0)
+	, quit(false)
+	{
+		pthread_mutex_init(&mutex, 0);
+		pthread_cond_init(&cond_start, 0);
+		pthread_cond_init(&cond_done, 0);
+	}
+
+	~sharded_index()
+	{
+		deinit();
+
+		pthread_cond_destroy(&cond_done);
+		pthread_cond_destroy(&cond_start);
+		pthread_mutex_destroy(&mutex);
+	}
+
+	// build from an array of keys sorted in ascending order, in up to the specified number of shards, each of
+	// them by its own thread, optionally pinned to the corresponding CPU in the array; a run of duplicate keys
+	// is never split across shards, which may reduce the shard count; return 0 on failure
+	size_t build(
+		const key_type* const src,
+		const size_t len_src,
+		const size_t max_shard,
+		const size_t* const cpu = 0)
+	{
+		deinit();
+
+		if (0 == len_src || 0 == max_shard)
+			return 0;
+
+		// shard boundaries, moved forward past runs of duplicates
+		aligned_ptr< size_t, CACHELINE_SIZE > begin(max_shard + 1);
+		size_t count = 0;
+
+		for (size_t i = 0; i < max_shard; ++i) {
+			size_t b = len_src * i / max_shard;
+
+			while (0 != b && b < len_src && src[b] == src[b - 1])
+				++b;
+
+			if (0 == count || b > begin[count - 1] && b < len_src)
+				begin[count++] = b;
+		}
+
+		begin[count] = len_src;
+
+		num_shard = count;
+		num_key = len_src;
+		shards = new shard[num_shard];
+		splitter.malloc(num_shard);
+		rings.malloc(num_shard * num_shard);
+
+		for (size_t i = 0; i < num_shard * num_shard; ++i)
+			rings[i].reset();
+
+		for (size_t i = 1; i < num_shard; ++i)
+			splitter[i - 1] = src[begin[i]];
+
+		num_built = 0;
+
+		for (size_t i = 0; i < num_shard; ++i) {
+			shards[i].engine = this;
+			shards[i].id = i;
+			shards[i].cpu = cpu ? cpu[i] : size_t(-1);
+			shards[i].rank_offset = begin[i];
+			shards[i].src = src + begin[i];
+			shards[i].size = begin[i + 1] - begin[i];
+			shards[i].built = 0;
+
+			if (pthread_create(&shards[i].thread, 0, shard_main, shards + i)) {
+				num_shard = i;
+				deinit();
+				return 0;
+			}
+		}
+
+		pthread_mutex_lock(&mutex);
+
+		while (num_built != num_shard)
+			pthread_cond_wait(&cond_done, &mutex);
+
+		pthread_mutex_unlock(&mutex);
+
+		for (size_t i = 0; i < num_shard; ++i)
+			if (!shards[i].built) {
+				deinit();
+				return 0;
+			}
+
+		return 1;
+	}
+
+	void deinit()
+	{
+		if (0 == shards)
+			return;
+
+		pthread_mutex_lock(&mutex);
+		quit = true;
+		pthread_cond_broadcast(&cond_start);
+		pthread_mutex_unlock(&mutex);
+
+		for (size_t i = 0; i < num_shard; ++i)
+			pthread_join(shards[i].thread, 0);
+
+		delete [] shards;
+		shards = 0;
+		num_shard = 0;
+		num_key = 0;
+		quit = false;
+	}
+
+	// number of keys in the index
+	size_t size() const
+	{
+		return num_key;
+	}
+
+	size_t shard_count() const
+	{
+		return num_shard;
+	}
+
+	const INDEX_T& shard_index(
+		const size_t i) const
+	{
+		return shards[i].index;
+	}
+
+	// search an array of keys using all shard threads; results are as by the batch searches of search::index,
+	// written to the same positions as their keys
+	void find(
+		const key_type* const key,
+		const size_t count,
+		size_t* const result)
+	{
+		run(key, count, result, false);
+	}
+
+	void lower_bound(
+		const key_type* const key,
+		const size_t count,
+		size_t* const result)
+	{
+		run(key, count, result, true);
+	}
+};
+
+} // namespace search
+
+#endif // shard_H__
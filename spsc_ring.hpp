@@ -0,0 +1,78 @@
+#ifndef spsc_ring_H__
+#define spsc_ring_H__
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Lock-free ring of POD items between a single producer thread and a single consumer thread. Items move in
+// batches, so that the cost of synchronisation is amortised over the batch. The head and tail counters run
+// freely and live on separate cache lines, so that the producer and the consumer do not false-share.
+template < typename T, size_t CAPACITY >
+class spsc_ring
+{
+	size_t head __attribute__ ((aligned(CACHELINE_SIZE))); // count of popped items, written by the consumer
+	size_t tail __attribute__ ((aligned(CACHELINE_SIZE))); // count of pushed items, written by the producer
+	T item[CAPACITY] __attribute__ ((aligned(CACHELINE_SIZE)));
+
+	spsc_ring(
+		const spsc_ring& src); // undefined
+
+	spsc_ring& operator =(
+		const spsc_ring& src); // undefined
+
+public:
+	spsc_ring()
+	: head(0)
+	, tail(0)
+	{
+		assert(0 == (CAPACITY & CAPACITY - 1));
+	}
+
+	// reset an empty ring; not thread-safe
+	void reset()
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	// push up to the specified number of items; return the number of items pushed
+	size_t push(
+		const T* const src,
+		const size_t count)
+	{
+		const size_t t = tail;
+		const size_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+		const size_t n = count < CAPACITY - (t - h) ? count : CAPACITY - (t - h);
+
+		for (size_t i = 0; i < n; ++i)
+			item[t + i & CAPACITY - 1] = src[i];
+
+		__atomic_store_n(&tail, t + n, __ATOMIC_RELEASE);
+		return n;
+	}
+
+	// pop up to the specified number of items; return the number of items popped
+	size_t pop(
+		T* const dst,
+		const size_t count)
+	{
+		const size_t h = head;
+		const size_t t = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+		const size_t n = count < t - h ? count : t - h;
+
+		for (size_t i = 0; i < n; ++i)
+			dst[i] = item[h + i & CAPACITY - 1];
+
+		__atomic_store_n(&head, h + n, __ATOMIC_RELEASE);
+		return n;
+	}
+
+	// number of items in the ring, as seen by either side
+	size_t size() const
+	{
+		return __atomic_load_n(&tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+	}
+};
+
+#endif // spsc_ring_H__
@@ -0,0 +1,299 @@
+#ifndef stream_H__
+#define stream_H__
+
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "aligned_ptr.hpp"
+#include "bsearch.hpp"
+
+namespace search {
+
+// A pipeline of exact-match searches over a stream of binary keys: a reader thread fills chunks of keys from an
+// input descriptor, the calling thread searches every chunk by the batch search of the index, and a writer thread
+// writes the positions of the chunk, as native size_t, npos for absent keys, to an output descriptor. Chunks go
+// round a fixed ring of buffers, so the three stages overlap across as many chunks as buffers and nothing is
+// allocated past construction. A read returns as soon as it has a whole number of keys, so a slow producer
+// does not hold up the keys it has already written; a trailing partial key is an error.
+template < typename INDEX_T >
+class stream_pipeline
+{
+public:
+	typedef typename INDEX_T::key_type key_type;
+
+	static const size_t num_buffer = 3;
+
+	struct stats {
+		size_t num_key;
+		size_t stall[3]; // number of chunks each stage, read, search and write, waited for
+	};
+
+private:
+	enum state {
+		state_free,     // to be filled by the reader
+		state_read,     // to be searched
+		state_searched  // to be written
+	};
+
+	struct buffer {
+		aligned_ptr< key_type, CACHELINE_SIZE > key;
+		aligned_ptr< size_t, CACHELINE_SIZE > result;
+		size_t count;
+		bool last; // no chunks past this one
+		state stage;
+	};
+
+	const INDEX_T& index;
+	const size_t chunk;
+	buffer buf[num_buffer];
+
+	int fd_in;
+	int fd_out;
+	int error; // errno of the first failed read or write, or -1 for a trailing partial key
+	stats stat;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	stream_pipeline(
+		const stream_pipeline& src); // undefined
+
+	stream_pipeline& operator =(
+		const stream_pipeline& src); // undefined
+
+	// wait for the buffer to reach the state, counting a stall if it has not yet
+	buffer& acquire(
+		const size_t i,
+		const state s,
+		size_t& stall)
+	{
+		buffer& b = buf[i % num_buffer];
+
+		pthread_mutex_lock(&mutex);
+
+		if (s != b.stage)
+			++stall;
+
+		while (s != b.stage)
+			pthread_cond_wait(&cond, &mutex);
+
+		pthread_mutex_unlock(&mutex);
+		return b;
+	}
+
+	void release(
+		buffer& b,
+		const state s)
+	{
+		pthread_mutex_lock(&mutex);
+		b.stage = s;
+		pthread_cond_broadcast(&cond);
+		pthread_mutex_unlock(&mutex);
+	}
+
+	void fail(
+		const int err)
+	{
+		pthread_mutex_lock(&mutex);
+
+		if (0 == error)
+			error = err;
+
+		pthread_mutex_unlock(&mutex);
+	}
+
+	// read a whole number of keys, up to a chunk; return the number of keys read, 0 at the end of the input or on error
+	size_t read_chunk(
+		key_type* const key)
+	{
+		uint8_t* const dst = reinterpret_cast< uint8_t* >(key);
+		const size_t len = chunk * sizeof(key_type);
+		size_t done = 0;
+
+		do {
+			const ssize_t n = read(fd_in, dst + done, len - done);
+
+			if (0 > n) {
+				if (EINTR == errno)
+					continue;
+
+				fail(errno);
+				return 0;
+			}
+
+			if (0 == n) {
+				if (done % sizeof(key_type))
+					fail(-1);
+
+				break;
+			}
+
+			done += size_t(n);
+		}
+		while (done % sizeof(key_type));
+
+		return done / sizeof(key_type);
+	}
+
+	bool write_all(
+		const void* const src,
+		const size_t len)
+	{
+		const uint8_t* const p = reinterpret_cast< const uint8_t* >(src);
+
+		for (size_t done = 0; done < len; ) {
+			const ssize_t n = write(fd_out, p + done, len - done);
+
+			if (0 > n) {
+				if (EINTR == errno)
+					continue;
+
+				fail(errno);
+				return false;
+			}
+
+			done += size_t(n);
+		}
+
+		return true;
+	}
+
+	static void* reader_main(
+		void* arg)
+	{
+		stream_pipeline& self = *reinterpret_cast< stream_pipeline* >(arg);
+
+		for (size_t i = 0; ; ++i) {
+			buffer& b = self.acquire(i, state_free, self.stat.stall[0]);
+
+			b.count = self.read_chunk(b.key);
+			b.last = 0 == b.count;
+			self.release(b, state_read);
+
+			if (b.last)
+				return 0;
+		}
+	}
+
+	// after a failed write the writer keeps draining the chunks, so that the other stages run to completion
+	static void* writer_main(
+		void* arg)
+	{
+		stream_pipeline& self = *reinterpret_cast< stream_pipeline* >(arg);
+		bool ok = true;
+
+		for (size_t i = 0; ; ++i) {
+			buffer& b = self.acquire(i, state_searched, self.stat.stall[2]);
+			const bool last = b.last;
+
+			if (ok && b.count)
+				ok = self.write_all(b.result, b.count * sizeof(size_t));
+
+			self.release(b, state_free);
+
+			if (last)
+				return 0;
+		}
+	}
+
+public:
+	// a pipeline over the index, of the specified number of keys per chunk
+	stream_pipeline(
+		const INDEX_T& index,
+		const size_t chunk)
+	: index(index)
+	, chunk(chunk)
+	, fd_in(-1)
+	, fd_out(-1)
+	, error(0)
+	{
+		for (size_t i = 0; i < num_buffer; ++i) {
+			buf[i].key.malloc(chunk);
+			buf[i].result.malloc(chunk);
+		}
+
+		pthread_mutex_init(&mutex, 0);
+		pthread_cond_init(&cond, 0);
+	}
+
+	~stream_pipeline()
+	{
+		pthread_cond_destroy(&cond);
+		pthread_mutex_destroy(&mutex);
+	}
+
+	// search all keys of the input, writing their positions to the output; return 0 and the errno of the first
+	// failed read or write or thread creation, or -1 for a trailing partial key, on failure; the stats cover the
+	// keys searched
+	size_t run(
+		const int in,
+		const int out,
+		stats& st,
+		int& err)
+	{
+		fd_in = in;
+		fd_out = out;
+		error = 0;
+		stat.num_key = 0;
+		stat.stall[0] = 0;
+		stat.stall[1] = 0;
+		stat.stall[2] = 0;
+
+		for (size_t i = 0; i < num_buffer; ++i)
+			buf[i].stage = state_free;
+
+		pthread_t reader, writer;
+
+		// pthread_create returns its error rather than setting errno
+		if (const int res = pthread_create(&reader, 0, reader_main, this)) {
+			err = res;
+			return 0;
+		}
+
+		if (const int res = pthread_create(&writer, 0, writer_main, this)) {
+			err = res;
+
+			// let the reader run to the end of the input, taking the place of the writer
+			for (size_t i = 0; ; ++i) {
+				buffer& b = acquire(i, state_read, stat.stall[1]);
+				const bool last = b.last;
+
+				release(b, state_free);
+
+				if (last)
+					break;
+			}
+
+			pthread_join(reader, 0);
+			return 0;
+		}
+
+		for (size_t i = 0; ; ++i) {
+			buffer& b = acquire(i, state_read, stat.stall[1]);
+			const bool last = b.last;
+
+			if (b.count)
+				index.find(b.key, b.count, b.result);
+
+			stat.num_key += b.count;
+			release(b, state_searched);
+
+			if (last)
+				break;
+		}
+
+		pthread_join(reader, 0);
+		pthread_join(writer, 0);
+
+		st = stat;
+		err = error;
+
+		return 0 == error;
+	}
+};
+
+} // namespace search
+
+#endif // stream_H__
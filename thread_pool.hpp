@@ -0,0 +1,285 @@
+#ifndef thread_pool_H__
+#define thread_pool_H__
+
+#include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "aligned_ptr.hpp"
+#include "topology.hpp"
+
+// A persistent pool of worker threads processing jobs made of independent chunks. The chunks of a job are split
+// evenly among the workers up front; a worker out of chunks steals half of the remaining chunks of another worker.
+// The thread calling run() acts as worker 0 for the duration of the job.
+class thread_pool
+{
+public:
+	typedef void (* task)(void* arg, size_t chunk, size_t worker);
+
+private:
+	// per-worker state, one cache line each, so that workers don't false-share their ranges
+	struct slot {
+		uint64_t range; // remaining chunks of the worker, [begin, end) packed as begin | end << 32
+		thread_pool* pool;
+		size_t id;
+		size_t cpu; // CPU the worker is pinned to, or size_t(-1)
+		pthread_t thread;
+	} __attribute__ ((aligned(CACHELINE_SIZE)));
+
+	aligned_ptr< slot, CACHELINE_SIZE > slots;
+	size_t num_worker;
+	size_t num_active;
+	uint64_t generation;
+	bool quit;
+
+	task job;
+	void* job_arg;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond_start;
+	pthread_cond_t cond_done;
+
+#if __linux__ != 0
+	cpu_set_t caller_affinity; // affinity of the calling thread prior to pinning it as worker 0
+	bool caller_pinned;
+
+#endif
+	thread_pool(
+		const thread_pool& src); // undefined
+
+	thread_pool& operator =(
+		const thread_pool& src); // undefined
+
+	static uint64_t pack(
+		const uint64_t begin,
+		const uint64_t end)
+	{
+		return begin | end << 32;
+	}
+
+	bool pop(
+		const size_t id,
+		size_t& chunk)
+	{
+		uint64_t& range = slots[id].range;
+		uint64_t r = __atomic_load_n(&range, __ATOMIC_ACQUIRE);
+
+		for (;;) {
+			const uint64_t begin = r & 0xffffffff;
+			const uint64_t end = r >> 32;
+
+			if (begin >= end)
+				return false;
+
+			if (__atomic_compare_exchange_n(&range, &r, pack(begin + 1, end), true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				chunk = size_t(begin);
+				return true;
+			}
+		}
+	}
+
+	// move the back half of the chunks of the first non-empty victim to the thief; victims are visited in a
+	// round-robin order starting past the thief, so that thieves spread over the victims
+	bool steal(
+		const size_t id)
+	{
+		for (size_t i = 1; i < num_worker; ++i) {
+			uint64_t& range = slots[(id + i) % num_worker].range;
+			uint64_t r = __atomic_load_n(&range, __ATOMIC_ACQUIRE);
+
+			for (;;) {
+				const uint64_t begin = r & 0xffffffff;
+				const uint64_t end = r >> 32;
+
+				if (begin >= end)
+					break;
+
+				const uint64_t mid = begin + (end - begin) / 2;
+
+				if (__atomic_compare_exchange_n(&range, &r, pack(begin, mid), true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+					__atomic_store_n(&slots[id].range, pack(mid, end), __ATOMIC_RELEASE);
+					return true;
+				}
+			}
+		}
+
+		// no chunks left to steal; any chunks in transit are processed by their thieves
+		return false;
+	}
+
+	void work(
+		const size_t id)
+	{
+		do {
+			size_t chunk;
+
+			while (pop(id, chunk))
+				job(job_arg, chunk, id);
+		}
+		while (steal(id));
+	}
+
+	static void* worker_main(
+		void* arg)
+	{
+		slot& self = *reinterpret_cast< slot* >(arg);
+		thread_pool& pool = *self.pool;
+		uint64_t seen = 0;
+
+		if (size_t(-1) != self.cpu)
+			pin_thread(self.cpu);
+
+		for (;;) {
+			pthread_mutex_lock(&pool.mutex);
+
+			while (seen == pool.generation && !pool.quit)
+				pthread_cond_wait(&pool.cond_start, &pool.mutex);
+
+			seen = pool.generation;
+			const bool quit = pool.quit;
+
+			pthread_mutex_unlock(&pool.mutex);
+
+			if (quit)
+				return 0;
+
+			pool.work(self.id);
+
+			pthread_mutex_lock(&pool.mutex);
+
+			if (0 == --pool.num_active)
+				pthread_cond_signal(&pool.cond_done);
+
+			pthread_mutex_unlock(&pool.mutex);
+		}
+	}
+
+public:
+	thread_pool()
+	: num_worker(0)
+	, num_active(0)
+	, generation(0)
+	, quit(false)
+	, job(0)
+	, job_arg(0)
+#if __linux__ != 0
+	, caller_pinned(false)
+#endif
+	{
+		pthread_mutex_init(&mutex, 0);
+		pthread_cond_init(&cond_start, 0);
+		pthread_cond_init(&cond_done, 0);
+	}
+
+	~thread_pool()
+	{
+		deinit();
+
+		pthread_cond_destroy(&cond_done);
+		pthread_cond_destroy(&cond_start);
+		pthread_mutex_destroy(&mutex);
+	}
+
+	// start the specified number of workers, the calling thread included; optionally pin each worker to the
+	// corresponding CPU in the array, the calling thread until deinit(); return 0 on failure
+	size_t init(
+		const size_t count,
+		const size_t* const cpu = 0)
+	{
+		deinit();
+
+		if (0 == count)
+			return 0;
+
+		slots.malloc(count);
+
+		for (size_t i = 0; i < count; ++i) {
+			slots[i].range = 0;
+			slots[i].pool = this;
+			slots[i].id = i;
+			slots[i].cpu = cpu ? cpu[i] : size_t(-1);
+		}
+
+#if __linux__ != 0
+		if (cpu && 0 == pthread_getaffinity_np(pthread_self(), sizeof(caller_affinity), &caller_affinity))
+			caller_pinned = pin_thread(cpu[0]);
+
+#endif
+
+		num_worker = 1;
+
+		for (size_t i = 1; i < count; ++i, ++num_worker)
+			if (pthread_create(&slots[i].thread, 0, worker_main, &slots[i])) {
+				deinit();
+				return 0;
+			}
+
+		return 1;
+	}
+
+	void deinit()
+	{
+		if (0 == num_worker)
+			return;
+
+		pthread_mutex_lock(&mutex);
+		quit = true;
+		pthread_cond_broadcast(&cond_start);
+		pthread_mutex_unlock(&mutex);
+
+		for (size_t i = 1; i < num_worker; ++i)
+			pthread_join(slots[i].thread, 0);
+
+		slots.free();
+		num_worker = 0;
+		quit = false;
+
+#if __linux__ != 0
+		if (caller_pinned)
+			pthread_setaffinity_np(pthread_self(), sizeof(caller_affinity), &caller_affinity);
+
+		caller_pinned = false;
+
+#endif
+	}
+
+	// number of workers, the calling thread included
+	size_t size() const
+	{
+		return num_worker;
+	}
+
+	// process chunks 0 through num_chunk - 1 of a job, each by a single call to the task; return once all
+	// chunks are processed and all workers are idle
+	void run(
+		const task fn,
+		void* const arg,
+		const size_t num_chunk)
+	{
+		assert(0 != num_worker);
+		assert(uint64_t(num_chunk) >> 32 == 0);
+
+		for (size_t i = 0; i < num_worker; ++i)
+			slots[i].range = pack(num_chunk * i / num_worker, num_chunk * (i + 1) / num_worker);
+
+		pthread_mutex_lock(&mutex);
+		job = fn;
+		job_arg = arg;
+		num_active = num_worker - 1;
+		++generation;
+		pthread_cond_broadcast(&cond_start);
+		pthread_mutex_unlock(&mutex);
+
+		work(0);
+
+		// wait for stragglers still scanning for victims, so that no steal outlives the job
+		pthread_mutex_lock(&mutex);
+
+		while (num_active)
+			pthread_cond_wait(&cond_done, &mutex);
+
+		pthread_mutex_unlock(&mutex);
+	}
+};
+
+#endif // thread_pool_H__
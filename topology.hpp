@@ -0,0 +1,248 @@
+#ifndef topology_H__
+#define topology_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if __linux__ != 0
+#include <sched.h>
+#include <sys/syscall.h>
+
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
+#endif
+
+// CPUs and NUMA nodes of the host, as listed in sysfs. Hosts without NUMA info, including all non-linux hosts,
+// read as a single node of all online CPUs. Nodes without CPUs are omitted.
+class topology
+{
+public:
+	static const size_t max_cpu = 1024;
+	static const size_t max_node = 64;
+
+private:
+	size_t num_node;
+	size_t num_cpu;
+	uint16_t cpu[max_cpu];             // online CPUs grouped by node
+	uint16_t node_begin[max_node + 1]; // CPUs of node n are cpu[node_begin[n]] through cpu[node_begin[n + 1] - 1]
+	uint16_t node[max_node];           // system id of node n
+
+public:
+	// parse a sysfs cpulist of the form "0-3,8,10-11"; return the number of CPUs stored
+	static size_t parse_cpulist(
+		const char* const path,
+		uint16_t* const list,
+		const size_t capacity)
+	{
+		FILE* const f = fopen(path, "r");
+
+		if (0 == f)
+			return 0;
+
+		size_t count = 0;
+		unsigned first, last;
+
+		while (1 == fscanf(f, "%u", &first)) {
+			last = first;
+
+			const int c = fgetc(f);
+
+			if ('-' == c)
+				fscanf(f, "%u", &last);
+			else
+				ungetc(c, f);
+
+			for (unsigned i = first; i <= last && count < capacity; ++i)
+				list[count++] = uint16_t(i);
+
+			if (',' != fgetc(f))
+				break;
+		}
+
+		fclose(f);
+		return count;
+	}
+
+	topology()
+	: num_node(0)
+	, num_cpu(0)
+	{
+#if __linux__ != 0
+		for (size_t i = 0; i < max_node; ++i) {
+			char path[64];
+			snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", unsigned(i));
+
+			const size_t count = parse_cpulist(path, cpu + num_cpu, max_cpu - num_cpu);
+
+			if (0 == count)
+				continue;
+
+			node[num_node] = uint16_t(i);
+			node_begin[num_node++] = uint16_t(num_cpu);
+			num_cpu += count;
+		}
+
+#endif
+		if (0 == num_node) {
+			const long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+			num_cpu = 0 < online && size_t(online) < max_cpu ? size_t(online) : 1;
+
+			for (size_t i = 0; i < num_cpu; ++i)
+				cpu[i] = uint16_t(i);
+
+			node[0] = 0;
+			node_begin[0] = 0;
+			num_node = 1;
+		}
+
+		node_begin[num_node] = uint16_t(num_cpu);
+	}
+
+	size_t nodes() const
+	{
+		return num_node;
+	}
+
+	size_t cpus() const
+	{
+		return num_cpu;
+	}
+
+	// system id of the specified node
+	size_t node_id(
+		const size_t n) const
+	{
+		return node[n];
+	}
+
+	size_t node_cpus(
+		const size_t n) const
+	{
+		return node_begin[n + 1] - node_begin[n];
+	}
+
+	size_t node_cpu(
+		const size_t n,
+		const size_t i) const
+	{
+		return cpu[node_begin[n] + i];
+	}
+
+	// first SMT sibling of the specified CPU, i.e. a hardware thread sharing its core, or size_t(-1) if none
+	static size_t smt_sibling(
+		const size_t cpu)
+	{
+		char path[96];
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", unsigned(cpu));
+
+		uint16_t sibling[max_cpu];
+		const size_t count = parse_cpulist(path, sibling, max_cpu);
+
+		for (size_t i = 0; i < count; ++i)
+			if (sibling[i] != cpu)
+				return sibling[i];
+
+		return size_t(-1);
+	}
+
+	// CPU and node of a worker when spreading workers across nodes round-robin, so that all nodes take part at
+	// any worker count; workers in excess of the CPUs of a node share CPUs
+	size_t worker_cpu(
+		const size_t worker,
+		size_t& n) const
+	{
+		n = worker % num_node;
+		return node_cpu(n, worker / num_node % node_cpus(n));
+	}
+};
+
+// pin the calling thread to the specified CPU; return 0 on failure, or where unsupported
+inline size_t pin_thread(
+	const size_t cpu)
+{
+#if __linux__ != 0
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+
+	return 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+#else
+	return 0;
+
+#endif
+}
+
+// interleave the pages spanning the specified memory across all nodes with CPUs, migrating pages already
+// faulted in; return 0 on failure, or where unsupported
+inline size_t interleave_pages(
+	const void* const ptr,
+	const size_t size,
+	const topology& topo)
+{
+	if (2 > topo.nodes())
+		return 1;
+
+#if __linux__ != 0 && defined(SYS_mbind)
+	const size_t bits_per_word = sizeof(unsigned long) * 8;
+	unsigned long mask[topology::max_node / bits_per_word] = { 0 };
+
+	for (size_t i = 0; i < topo.nodes(); ++i)
+		mask[topo.node_id(i) / bits_per_word] |= 1UL << topo.node_id(i) % bits_per_word;
+
+	const uintptr_t page = uintptr_t(sysconf(_SC_PAGESIZE));
+	const uintptr_t begin = uintptr_t(ptr) & ~(page - 1);
+	const uintptr_t end = uintptr_t(ptr) + size + page - 1 & ~(page - 1);
+
+	return 0 == syscall(SYS_mbind, begin, end - begin, MPOL_INTERLEAVE, mask, topology::max_node + 1, MPOL_MF_MOVE);
+
+#else
+	return 0;
+
+#endif
+}
+
+struct pinned_call
+{
+	size_t cpu;
+	void (* fn)(void*);
+	void* arg;
+
+	static void* entry(
+		void* arg)
+	{
+		pinned_call& call = *reinterpret_cast< pinned_call* >(arg);
+
+		pin_thread(call.cpu);
+		call.fn(call.arg);
+
+		return 0;
+	}
+};
+
+// call a function on a thread pinned to the specified CPU, e.g. to first-touch memory on the node of the CPU;
+// return 0 on failure to start the thread
+inline size_t run_pinned(
+	const size_t cpu,
+	void (* const fn)(void*),
+	void* const arg)
+{
+	pinned_call call = { cpu, fn, arg };
+	pthread_t thread;
+
+	if (pthread_create(&thread, 0, pinned_call::entry, &call))
+		return 0;
+
+	pthread_join(thread, 0);
+	return 1;
+}
+
+#endif // topology_H__
@@ -0,0 +1,341 @@
+#ifndef trace_H__
+#define trace_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "aligned_ptr.hpp"
+
+namespace search {
+
+// Traces of queries, for capture and replay: a header, then fixed-size records packed back to back, each a key,
+// optionally the id of the table searched, and optionally the time the query arrived, in nanoseconds since the
+// first query. The header tells the size and kind of the keys and which fields the records carry, so that a trace
+// is never replayed with keys of another type. Fields are in native byte order.
+enum trace_field {
+	trace_table = 1, // records carry a 32-bit table id
+	trace_time = 2   // records carry a 64-bit arrival time
+};
+
+enum trace_kind {
+	trace_unsigned,
+	trace_signed,
+	trace_float
+};
+
+struct trace_header {
+	char magic[8];
+	uint32_t key_size;
+	uint32_t key_kind;
+	uint32_t fields;
+	uint32_t record_size;
+	uint64_t num_record;
+};
+
+template < typename KEY_T >
+inline uint32_t trace_key_kind()
+{
+	return KEY_T(.5) != KEY_T(0) ? trace_float : KEY_T(-1) < KEY_T(0) ? trace_signed : trace_unsigned;
+}
+
+inline const char* trace_magic()
+{
+	return "bsrchtr1";
+}
+
+inline size_t trace_record_size(
+	const size_t key_size,
+	const uint32_t fields)
+{
+	return key_size + (fields & trace_table ? sizeof(uint32_t) : 0) + (fields & trace_time ? sizeof(uint64_t) : 0);
+}
+
+// Appends records to a trace file through a buffer of records; the count of records goes to the header on close.
+template < typename KEY_T >
+class trace_writer
+{
+	static const size_t buffer_size = 1 << 20; // bytes of records per write
+
+	aligned_ptr< uint8_t, CACHELINE_SIZE > buffer;
+	size_t fill;
+	int fd;
+	uint32_t fields;
+	size_t record_size;
+	uint64_t num_record;
+	bool failed;
+
+	trace_writer(
+		const trace_writer& src); // undefined
+
+	trace_writer& operator =(
+		const trace_writer& src); // undefined
+
+	bool write_all(
+		const void* const src,
+		const size_t size)
+	{
+		for (size_t done = 0; done < size; ) {
+			const ssize_t n = ::write(fd, reinterpret_cast< const uint8_t* >(src) + done, size - done);
+
+			if (0 >= n)
+				return false;
+
+			done += size_t(n);
+		}
+
+		return true;
+	}
+
+	void flush()
+	{
+		if (fill && !failed)
+			failed = !write_all(buffer, fill);
+
+		fill = 0;
+	}
+
+public:
+	trace_writer()
+	: fill(0)
+	, fd(-1)
+	, fields(0)
+	, record_size(0)
+	, num_record(0)
+	, failed(false)
+	{
+	}
+
+	~trace_writer()
+	{
+		close();
+	}
+
+	// create a trace of records of the specified trace_field flags; return 0 on failure
+	size_t open(
+		const char* const path,
+		const uint32_t new_fields)
+	{
+		close();
+
+		fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		if (0 > fd)
+			return 0;
+
+		trace_header h;
+		memset(&h, 0, sizeof(h));
+
+		if (!write_all(&h, sizeof(h))) {
+			::close(fd);
+			fd = -1;
+			return 0;
+		}
+
+		if (buffer.is_null())
+			buffer.malloc(buffer_size);
+
+		fill = 0;
+		fields = new_fields;
+		record_size = trace_record_size(sizeof(KEY_T), fields);
+		num_record = 0;
+		failed = false;
+
+		return 1;
+	}
+
+	// fields the trace does not carry are dropped
+	void append(
+		const KEY_T key,
+		const uint32_t table = 0,
+		const uint64_t time = 0)
+	{
+		if (buffer_size - fill < record_size)
+			flush();
+
+		uint8_t* p = buffer + fill;
+
+		memcpy(p, &key, sizeof(key));
+		p += sizeof(key);
+
+		if (fields & trace_table) {
+			memcpy(p, &table, sizeof(table));
+			p += sizeof(table);
+		}
+
+		if (fields & trace_time)
+			memcpy(p, &time, sizeof(time));
+
+		fill += record_size;
+		++num_record;
+	}
+
+	// write the remaining records and the header; return 0 if any write failed
+	size_t close()
+	{
+		if (0 > fd)
+			return 0;
+
+		flush();
+
+		trace_header h;
+		memcpy(h.magic, trace_magic(), sizeof(h.magic));
+		h.key_size = sizeof(KEY_T);
+		h.key_kind = trace_key_kind< KEY_T >();
+		h.fields = fields;
+		h.record_size = uint32_t(record_size);
+		h.num_record = num_record;
+
+		const bool success = !failed && sizeof(h) == size_t(pwrite(fd, &h, sizeof(h), 0)) && 0 == fsync(fd);
+
+		::close(fd);
+		fd = -1;
+
+		return success;
+	}
+};
+
+// Read-only view of a trace file through a mapping, so that traces need not fit in memory: the pages of the
+// records are read as replay reaches them, ahead of it by the read-ahead of sequential access.
+template < typename KEY_T >
+class trace_reader
+{
+	const uint8_t* map;
+	size_t map_size;
+	uint32_t fields;
+	size_t record_size;
+	size_t num_record;
+
+	trace_reader(
+		const trace_reader& src); // undefined
+
+	trace_reader& operator =(
+		const trace_reader& src); // undefined
+
+	const uint8_t* record(
+		const size_t i) const
+	{
+		return map + sizeof(trace_header) + i * record_size;
+	}
+
+public:
+	trace_reader()
+	: map(0)
+	, map_size(0)
+	, fields(0)
+	, record_size(0)
+	, num_record(0)
+	{
+	}
+
+	~trace_reader()
+	{
+		close();
+	}
+
+	// map a trace of keys of the type; return 0 on failure, or if the trace is of keys of another type or truncated
+	size_t open(
+		const char* const path)
+	{
+		close();
+
+		const int fd = ::open(path, O_RDONLY);
+
+		if (0 > fd)
+			return 0;
+
+		struct stat st;
+		trace_header h;
+
+		if (fstat(fd, &st) || size_t(st.st_size) < sizeof(h) || sizeof(h) != size_t(pread(fd, &h, sizeof(h), 0)) ||
+			memcmp(h.magic, trace_magic(), sizeof(h.magic)) || sizeof(KEY_T) != h.key_size ||
+			trace_key_kind< KEY_T >() != h.key_kind || trace_record_size(h.key_size, h.fields) != h.record_size ||
+			(size_t(st.st_size) - sizeof(h)) / h.record_size < h.num_record) {
+			::close(fd);
+			return 0;
+		}
+
+		void* const p = mmap(0, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+
+		if (MAP_FAILED == p)
+			return 0;
+
+#if defined(MADV_SEQUENTIAL)
+		madvise(p, size_t(st.st_size), MADV_SEQUENTIAL);
+
+#endif
+		map = reinterpret_cast< const uint8_t* >(p);
+		map_size = size_t(st.st_size);
+		fields = h.fields;
+		record_size = h.record_size;
+		num_record = size_t(h.num_record);
+
+		return 1;
+	}
+
+	void close()
+	{
+		if (map)
+			munmap(const_cast< uint8_t* >(map), map_size);
+
+		map = 0;
+		map_size = 0;
+		num_record = 0;
+	}
+
+	// number of records of the trace
+	size_t size() const
+	{
+		return num_record;
+	}
+
+	bool has_table() const
+	{
+		return fields & trace_table;
+	}
+
+	bool has_time() const
+	{
+		return fields & trace_time;
+	}
+
+	KEY_T key(
+		const size_t i) const
+	{
+		KEY_T k;
+		memcpy(&k, record(i), sizeof(k));
+		return k;
+	}
+
+	// table id of the record, 0 if the trace carries none
+	uint32_t table(
+		const size_t i) const
+	{
+		uint32_t t = 0;
+
+		if (fields & trace_table)
+			memcpy(&t, record(i) + sizeof(KEY_T), sizeof(t));
+
+		return t;
+	}
+
+	// arrival time of the record, 0 if the trace carries none
+	uint64_t time(
+		const size_t i) const
+	{
+		uint64_t t = 0;
+
+		if (fields & trace_time)
+			memcpy(&t, record(i) + record_size - sizeof(t), sizeof(t));
+
+		return t;
+	}
+};
+
+} // namespace search
+
+#endif // trace_H__
@@ -0,0 +1,548 @@
+#ifndef update_H__
+#define update_H__
+
+#include <sched.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "aligned_ptr.hpp"
+#include "bsearch.hpp"
+
+namespace search {
+
+// A set of keys taking inserts and erasures while serving lookups. Keys live in a static search::index of the
+// layout, the base, plus a small delta of the updates since the base was built: a sorted array, and a short
+// unsorted tail of the latest updates, scanned linearly. An update appends to the tail of the current version;
+// a full tail is folded into the sorted array of a new version, published by a single pointer swap. Once the
+// delta reaches a threshold, a background thread merges it into a new base and publishes that the same way.
+// Readers never block nor write shared state other than their own epoch slot: a version is freed only after every
+// reader that could have seen it is done, as told by the epochs of the readers (epoch-based reclamation). Updates
+// are serialised by a mutex.
+template < typename KEY_T, typename LAYOUT_T >
+class updatable_index
+{
+public:
+	typedef KEY_T key_type;
+	typedef LAYOUT_T layout_type;
+
+	static const size_t max_reader = 256; // number of reader slots; reader ids are 0 through max_reader - 1
+
+private:
+	struct entry {
+		KEY_T key;
+		uint32_t erased; // entry is a tombstone
+		uint64_t seq;    // sequence number of the update
+	};
+
+	struct base {
+		index< KEY_T, LAYOUT_T > space;
+		aligned_ptr< KEY_T, CACHELINE_SIZE > key; // keys of the index, for the merges
+		size_t count;
+	};
+
+	static const size_t tail_capacity = 32; // number of updates appended to a version before it is replaced
+
+	struct version {
+		base* b;
+		aligned_ptr< entry, CACHELINE_SIZE > delta; // sorted by key, one entry per key
+		size_t delta_count;
+		size_t tail_count; // grows while the version is current; entries below the count are immutable
+		entry tail[tail_capacity]; // in the order of the updates
+	};
+
+	struct retired {
+		version* v;
+		base* b;        // base no longer referenced by the current version, or null
+		uint64_t epoch; // global epoch at the time of retirement
+	};
+
+	// epoch of a reader within a lookup, 0 outside of lookups
+	struct reader_slot {
+		uint64_t epoch;
+	} __attribute__ ((aligned(CACHELINE_SIZE)));
+
+	static const size_t max_retired = 1024; // number of versions awaiting reclamation before updates stall
+	static const size_t rebuild_slot = max_reader; // slot of the rebuild thread
+
+	version* current;
+	uint64_t global_epoch __attribute__ ((aligned(CACHELINE_SIZE)));
+	aligned_ptr< reader_slot, CACHELINE_SIZE > slots;
+
+	// writer state, guarded by the mutex
+	retired retire_list[max_retired];
+	size_t num_retired;
+	uint64_t seq;
+	size_t threshold;
+	size_t num_rebuild;
+	bool rebuild_requested;
+	bool quit;
+	bool started;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond_rebuild;
+	pthread_t thread;
+
+	updatable_index(
+		const updatable_index& src); // undefined
+
+	updatable_index& operator =(
+		const updatable_index& src); // undefined
+
+	// position of the first delta entry not less than the key
+	static size_t delta_lower_bound(
+		const version* const v,
+		const KEY_T key)
+	{
+		const entry* const delta = v->delta;
+		size_t lo = 0;
+		size_t hi = v->delta_count;
+
+		while (lo < hi) {
+			const size_t mid = lo + (hi - lo) / 2;
+
+			if (delta[mid].key < key)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		return lo;
+	}
+
+	static bool lookup(
+		const version* const v,
+		const KEY_T key)
+	{
+		for (size_t i = __atomic_load_n(&v->tail_count, __ATOMIC_ACQUIRE); i-- != 0; )
+			if (v->tail[i].key == key)
+				return !v->tail[i].erased;
+
+		const size_t pos = delta_lower_bound(v, key);
+
+		if (pos < v->delta_count && v->delta[pos].key == key)
+			return !v->delta[pos].erased;
+
+		return 0 != v->b->count && index< KEY_T, LAYOUT_T >::npos != v->b->space.find(key);
+	}
+
+	const version* enter(
+		const size_t reader)
+	{
+		// the slot must be visible before the version pointer is read, hence sequential consistency
+		__atomic_store_n(&slots[reader].epoch, __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+		return __atomic_load_n(&current, __ATOMIC_SEQ_CST);
+	}
+
+	void leave(
+		const size_t reader)
+	{
+		__atomic_store_n(&slots[reader].epoch, 0, __ATOMIC_RELEASE);
+	}
+
+	// free the retired versions no reader can see any more; mutex held
+	void reclaim()
+	{
+		uint64_t min_epoch = uint64_t(-1);
+
+		for (size_t i = 0; i <= max_reader; ++i) {
+			const uint64_t e = __atomic_load_n(&slots[i].epoch, __ATOMIC_SEQ_CST);
+
+			if (e && e < min_epoch)
+				min_epoch = e;
+		}
+
+		size_t kept = 0;
+
+		for (size_t i = 0; i < num_retired; ++i)
+			if (retire_list[i].epoch < min_epoch) {
+				delete retire_list[i].v;
+				delete retire_list[i].b;
+			}
+			else
+				retire_list[kept++] = retire_list[i];
+
+		num_retired = kept;
+	}
+
+	// wait for a free slot of the retire list; mutex held, but released while waiting, so the caller must read the
+	// current version only after
+	void make_room()
+	{
+		while (max_retired == num_retired) {
+			reclaim();
+
+			if (max_retired == num_retired) {
+				pthread_mutex_unlock(&mutex);
+				sched_yield();
+				pthread_mutex_lock(&mutex);
+			}
+		}
+	}
+
+	// make a version current, retiring its predecessor and optionally a base; mutex held, after make_room
+	void publish(
+		version* const v,
+		base* const b)
+	{
+		assert(max_retired > num_retired);
+
+		version* const prev = current;
+		__atomic_store_n(&current, v, __ATOMIC_SEQ_CST);
+
+		const retired r = { prev, b, __atomic_fetch_add(&global_epoch, 1, __ATOMIC_SEQ_CST) };
+		retire_list[num_retired++] = r;
+
+		reclaim();
+	}
+
+	// store in a version the latest entry per key among the entries of another version with sequence numbers
+	// above the specified one, tail entries up to the specified count, sorted by key; the tail is left empty
+	static void fold(
+		const version* const v,
+		const size_t tail_count,
+		const uint64_t seq_min,
+		version* const dst)
+	{
+		entry t[tail_capacity];
+		size_t nt = 0;
+
+		// insertion-sort the tail, later entries replacing earlier ones of the same key
+		for (size_t i = 0; i < tail_count; ++i) {
+			const entry& e = v->tail[i];
+
+			if (e.seq <= seq_min)
+				continue;
+
+			size_t j = nt;
+
+			while (j && e.key < t[j - 1].key)
+				--j;
+
+			if (j && e.key == t[j - 1].key) {
+				t[j - 1] = e;
+				continue;
+			}
+
+			for (size_t k = nt++; k > j; --k)
+				t[k] = t[k - 1];
+
+			t[j] = e;
+		}
+
+		// merge with the sorted entries, tail entries being the later ones
+		const entry* const delta = v->delta;
+
+		dst->delta.malloc(v->delta_count + nt);
+		dst->delta_count = 0;
+		dst->tail_count = 0;
+
+		for (size_t i = 0, j = 0; i < v->delta_count || j < nt; ) {
+			if (j == nt || i < v->delta_count && delta[i].key < t[j].key) {
+				if (delta[i].seq > seq_min)
+					dst->delta[dst->delta_count++] = delta[i];
+
+				++i;
+			}
+			else {
+				if (i < v->delta_count && delta[i].key == t[j].key)
+					++i;
+
+				dst->delta[dst->delta_count++] = t[j++];
+			}
+		}
+	}
+
+	// merge the base keys with the sorted delta of a version into a new base; return null on failure
+	static base* merge(
+		const version* const v)
+	{
+		const base& src = *v->b;
+		const entry* const delta = v->delta;
+		base* const b = new base;
+
+		b->key.malloc(src.count + v->delta_count);
+		b->count = 0;
+
+		for (size_t i = 0, j = 0; i < src.count || j < v->delta_count; ) {
+			if (j == v->delta_count || i < src.count && src.key[i] < delta[j].key)
+				b->key[b->count++] = src.key[i++];
+			else {
+				if (!delta[j].erased)
+					b->key[b->count++] = delta[j].key;
+
+				if (i < src.count && src.key[i] == delta[j].key)
+					++i;
+
+				++j;
+			}
+		}
+
+		if (b->count && !b->space.build(b->key, b->count)) {
+			delete b;
+			return 0;
+		}
+
+		return b;
+	}
+
+	void rebuild()
+	{
+		pthread_mutex_lock(&mutex);
+
+		// all entries of the current delta have sequence numbers up to the current one
+		const uint64_t seq_merged = seq;
+		const version* const v = enter(rebuild_slot);
+		const size_t tail_count = v->tail_count;
+
+		pthread_mutex_unlock(&mutex);
+
+		version snapshot;
+		snapshot.b = v->b;
+		fold(v, tail_count, 0, &snapshot);
+
+		base* const b = merge(&snapshot);
+
+		leave(rebuild_slot);
+		pthread_mutex_lock(&mutex);
+
+		if (b) {
+			make_room();
+
+			// carry over the updates made during the merge
+			const version* const cur = current;
+			version* const nv = new version;
+
+			nv->b = b;
+			fold(cur, cur->tail_count, seq_merged, nv);
+
+			publish(nv, cur->b);
+			++num_rebuild;
+		}
+
+		rebuild_requested = b && threshold <= current->delta_count + current->tail_count;
+		pthread_mutex_unlock(&mutex);
+	}
+
+	static void* rebuild_main(
+		void* arg)
+	{
+		updatable_index& self = *reinterpret_cast< updatable_index* >(arg);
+
+		for (;;) {
+			pthread_mutex_lock(&self.mutex);
+
+			while (!self.rebuild_requested && !self.quit)
+				pthread_cond_wait(&self.cond_rebuild, &self.mutex);
+
+			const bool quit = self.quit;
+
+			pthread_mutex_unlock(&self.mutex);
+
+			if (quit)
+				return 0;
+
+			self.rebuild();
+		}
+	}
+
+	size_t update(
+		const KEY_T key,
+		const bool erase)
+	{
+		pthread_mutex_lock(&mutex);
+		make_room();
+
+		version* v = current;
+		assert(0 != v);
+
+		if (lookup(v, key) != erase) {
+			pthread_mutex_unlock(&mutex);
+			return 0;
+		}
+
+		const entry e = { key, uint32_t(erase), ++seq };
+
+		if (tail_capacity == v->tail_count) {
+			version* const nv = new version;
+
+			nv->b = v->b;
+			fold(v, tail_capacity, 0, nv);
+			publish(nv, 0);
+
+			v = nv;
+		}
+
+		// the entry must be visible before the count that covers it
+		v->tail[v->tail_count] = e;
+		__atomic_store_n(&v->tail_count, v->tail_count + 1, __ATOMIC_RELEASE);
+
+		if (threshold <= v->delta_count + v->tail_count && !rebuild_requested) {
+			rebuild_requested = true;
+			pthread_cond_signal(&cond_rebuild);
+		}
+
+		pthread_mutex_unlock(&mutex);
+		return 1;
+	}
+
+	void stop()
+	{
+		if (!started)
+			return;
+
+		pthread_mutex_lock(&mutex);
+		quit = true;
+		pthread_cond_signal(&cond_rebuild);
+		pthread_mutex_unlock(&mutex);
+
+		pthread_join(thread, 0);
+
+		quit = false;
+		started = false;
+		rebuild_requested = false;
+	}
+
+public:
+	// rebuild once the delta holds the specified number of entries
+	updatable_index(
+		const size_t delta_threshold = 4096)
+	: current(0)
+	, global_epoch(1)
+	, slots(max_reader + 1)
+	, num_retired(0)
+	, seq(0)
+	, threshold(delta_threshold ? delta_threshold : 1)
+	, num_rebuild(0)
+	, rebuild_requested(false)
+	, quit(false)
+	, started(false)
+	{
+		for (size_t i = 0; i <= max_reader; ++i)
+			slots[i].epoch = 0;
+
+		pthread_mutex_init(&mutex, 0);
+		pthread_cond_init(&cond_rebuild, 0);
+	}
+
+	~updatable_index()
+	{
+		deinit();
+
+		pthread_cond_destroy(&cond_rebuild);
+		pthread_mutex_destroy(&mutex);
+	}
+
+	// build from an array of distinct keys sorted in ascending order, and start the rebuild thread; not
+	// thread-safe; return 0 on failure
+	size_t build(
+		const KEY_T* const src,
+		const size_t len_src)
+	{
+		deinit();
+
+		base* const b = new base;
+		b->key.malloc(len_src);
+		b->count = len_src;
+
+		for (size_t i = 0; i < len_src; ++i)
+			b->key[i] = src[i];
+
+		if (len_src && !b->space.build(b->key, len_src)) {
+			delete b;
+			return 0;
+		}
+
+		current = new version;
+		current->b = b;
+		current->delta_count = 0;
+		current->tail_count = 0;
+
+		if (pthread_create(&thread, 0, rebuild_main, this)) {
+			deinit();
+			return 0;
+		}
+
+		started = true;
+		return 1;
+	}
+
+	// stop the rebuild thread and free all versions; not thread-safe
+	void deinit()
+	{
+		stop();
+
+		for (size_t i = 0; i < num_retired; ++i) {
+			delete retire_list[i].v;
+			delete retire_list[i].b;
+		}
+
+		num_retired = 0;
+
+		if (current) {
+			delete current->b;
+			delete current;
+			current = 0;
+		}
+	}
+
+	// insert a key; return 0 if the key is present already
+	size_t insert(
+		const KEY_T key)
+	{
+		return update(key, false);
+	}
+
+	// erase a key; return 0 if the key is absent already
+	size_t erase(
+		const KEY_T key)
+	{
+		return update(key, true);
+	}
+
+	// look a key up on behalf of a reader, whose id must not be in use by another thread at the same time;
+	// wait-free
+	bool contains(
+		const size_t reader,
+		const KEY_T key)
+	{
+		assert(reader < max_reader);
+
+		const bool res = lookup(enter(reader), key);
+		leave(reader);
+
+		return res;
+	}
+
+	// number of keys in the base and number of entries in the delta of the current version
+	size_t base_size()
+	{
+		pthread_mutex_lock(&mutex);
+		const size_t res = current ? current->b->count : 0;
+		pthread_mutex_unlock(&mutex);
+
+		return res;
+	}
+
+	size_t delta_size()
+	{
+		pthread_mutex_lock(&mutex);
+		const size_t res = current ? current->delta_count + current->tail_count : 0;
+		pthread_mutex_unlock(&mutex);
+
+		return res;
+	}
+
+	// number of completed background rebuilds
+	size_t rebuilds()
+	{
+		pthread_mutex_lock(&mutex);
+		const size_t res = num_rebuild;
+		pthread_mutex_unlock(&mutex);
+
+		return res;
+	}
+};
+
+} // namespace search
+
+#endif // update_H__
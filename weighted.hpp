@@ -0,0 +1,417 @@
+#ifndef weighted_H__
+#define weighted_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "aligned_ptr.hpp"
+#include "compile_assert.hpp"
+
+namespace search {
+
+// A search tree of a sorted set of keys shaped by how often each key is queried, for skewed query streams: a
+// weight-balanced binary search tree, each node the key that best splits the query weight of its range, so that
+// hot keys sit near the root and a query takes about log2 of the inverse of its frequency levels, rather than log2
+// of the key count. Weights are blended with a share of uniform weight, which bounds the depth of the coldest keys
+// to a few levels past that of a balanced tree. The tree is cut into subtrees of as many levels as fit a cache
+// line, fewer where that leaves fewer blocks below, each subtree stored as a breadth-first block, the empty slots
+// of a block copying their parent, the child blocks of a block next to each other, and the blocks laid out level
+// by level.
+// A search touches one cache line per block, and the hot blocks at the top of the tree share the first lines.
+// Searches are exact-match only; find() returns layout positions, as bsearch_veb_iter does. Keys are of 4 bytes
+// or more.
+template < typename KEY_T >
+class weighted_tree
+{
+public:
+	static const size_t npos = size_t(-1);
+
+	// number of tree levels per block: slot 0 of a block holds the index of its first child block, slots 1 through
+	// 2^block_levels - 1 hold the nodes, so that a block takes a cache line of 4-byte keys
+	static const size_t block_levels =
+		16 * sizeof(KEY_T) <= CACHELINE_SIZE ? 4 :
+		8 * sizeof(KEY_T) <= CACHELINE_SIZE ? 3 :
+		4 * sizeof(KEY_T) <= CACHELINE_SIZE ? 2 : 1;
+	static const size_t block_slots = size_t(1) << block_levels;
+
+private:
+	static const uint32_t none = uint32_t(-1);
+
+	// exits of a block are numbered left to right below its bottom level; exit e of a block leads to child block
+	// first child + the number of exits below e with a child, bit e of the exit mask of the block telling if it
+	// has one; the masks are kept apart from the blocks, a mask per block being small enough to stay in the caches
+	typedef uint16_t exit_mask;
+
+	struct builder {
+		const KEY_T* key;
+		const double* prefix; // prefix sums of the blended weights, prefix[i] of keys 0 through i - 1
+		double uniform;       // uniform weight per key
+		uint32_t* left;
+		uint32_t* right;
+		double block_cost; // cost of a block, in weight of searches
+		double* cost;      // least cost of the subtree of the node: the weight of the searches through each block plus the cost of the blocks
+		uint32_t* count;   // number of blocks of the subtree of the node, in the cut of least cost
+		uint8_t* depth;    // number of levels of the block atop the subtree of the node, in the cut of least cost
+		KEY_T* space;
+		exit_mask* exits;
+		uint32_t* root;    // root of the subtree of each block, by block index
+		size_t num_block;  // number of blocks queued
+	};
+
+	aligned_ptr< KEY_T, CACHELINE_SIZE > space;
+	aligned_ptr< exit_mask, CACHELINE_SIZE > exits;
+	size_t num_key;
+	size_t num_block;
+
+	weighted_tree(
+		const weighted_tree& src); // undefined
+
+	weighted_tree& operator =(
+		const weighted_tree& src); // undefined
+
+	// root of the weight-balanced tree of the keys lo through hi - 1: the key at which the weight of the range is
+	// best split in half, by bisection of the prefix sums; a range of no more than twice its uniform weight is split
+	// at the median instead, so that cold ranges make complete subtrees, whatever the noise of their few counts
+	static uint32_t build_node(
+		builder& b,
+		const size_t lo,
+		const size_t hi)
+	{
+		if (lo == hi)
+			return none;
+
+		const double half = (b.prefix[lo] + b.prefix[hi]) * .5;
+		size_t l = lo + (hi - lo) / 2;
+
+		if (hi - lo >= block_slots && b.prefix[hi] - b.prefix[lo] > 2 * b.uniform * (hi - lo)) {
+			size_t h = hi - 1;
+
+			// the first key whose prefix sum through it reaches half of the range
+			for (l = lo; l < h; ) {
+				const size_t m = l + (h - l) / 2;
+
+				if (b.prefix[m + 1] < half)
+					l = m + 1;
+				else
+					h = m;
+			}
+
+			// or the one before, if that splits closer to half
+			if (l > lo && half - b.prefix[l] < b.prefix[l + 1] - half)
+				--l;
+		}
+
+		b.left[l] = build_node(b, lo, l);
+		b.right[l] = build_node(b, l + 1, hi);
+		choose_depth(b, uint32_t(l), b.prefix[hi] - b.prefix[lo]);
+
+		return uint32_t(l);
+	}
+
+	// cut of the subtree of the node into blocks, given those of the subtrees below: the block atop takes as many
+	// levels, up to a block, as leave the least cost below, ties going to the most levels. Cost is the number of
+	// blocks the searches touch plus the space the blocks take, so that blocks are full where searches are rare:
+	// cut at every few levels, the ragged bottom of the tree would end in blocks of a node or two
+	static void choose_depth(
+		builder& b,
+		const uint32_t root,
+		const double weight)
+	{
+		uint32_t level[block_slots];
+		size_t num_level = 1;
+		double best = 0;
+		size_t best_count = 0;
+		size_t best_depth = 0;
+
+		level[0] = root;
+
+		for (size_t depth = 1; depth <= block_levels && num_level; ++depth) {
+			uint32_t next[block_slots];
+			size_t num_next = 0;
+			double below = 0;
+			size_t below_count = 0;
+
+			for (size_t i = 0; i < num_level; ++i) {
+				const uint32_t sub[] = { b.left[level[i]], b.right[level[i]] };
+
+				for (size_t c = 0; c < 2; ++c)
+					if (none != sub[c]) {
+						next[num_next++] = sub[c];
+						below += b.cost[sub[c]];
+						below_count += b.count[sub[c]];
+					}
+			}
+
+			if (0 == best_depth || below <= best) {
+				best = below;
+				best_count = below_count;
+				best_depth = depth;
+			}
+
+			memcpy(level, next, num_next * sizeof(next[0]));
+			num_level = num_next;
+		}
+
+		b.cost[root] = best + weight + b.block_cost;
+		b.count[root] = uint32_t(best_count + 1);
+		b.depth[root] = uint8_t(best_depth);
+	}
+
+	// nodes of the block of the subtree of the root, by slot; none for the empty slots
+	static void block_nodes(
+		const builder& b,
+		const uint32_t root,
+		uint32_t (& node)[block_slots])
+	{
+		const size_t last = size_t(1) << b.depth[root]; // first slot past the levels of the block
+
+		node[0] = none;
+		node[1] = root;
+
+		for (size_t i = 2; i < block_slots; ++i) {
+			const uint32_t parent = node[i / 2];
+			node[i] = none == parent || i >= last ? none : i % 2 ? b.right[parent] : b.left[parent];
+		}
+	}
+
+	// roots of the subtrees below the block, by exit: a search for the keys of a subtree that leaves the block
+	// from a node of a level above the bottom one goes on through the empty slots, which copy the node, in the
+	// same direction down to an exit
+	static void block_exits(
+		const builder& b,
+		const uint32_t (& node)[block_slots],
+		uint32_t (& child)[block_slots])
+	{
+		for (size_t e = 0; e < block_slots; ++e)
+			child[e] = none;
+
+		for (size_t i = 1; i < block_slots; ++i) {
+			if (none == node[i])
+				continue;
+
+			for (size_t c = 0; c < 2; ++c) {
+				const uint32_t sub = c ? b.right[node[i]] : b.left[node[i]];
+				size_t j = i * 2 + c;
+
+				if (none == sub || j < block_slots && none != node[j])
+					continue;
+
+				while (j < block_slots)
+					j = j * 2 + c;
+
+				child[j - block_slots] = sub;
+			}
+		}
+	}
+
+	// write the block of the specified index, queueing the roots of its child blocks to follow the blocks queued
+	// so far, so that blocks are laid out level by level, as VEB lays out its subtrees, the hot shallow blocks
+	// packed at the start of the space
+	static void emit_block(
+		builder& b,
+		const size_t index)
+	{
+		uint32_t node[block_slots];
+		uint32_t child[block_slots];
+		KEY_T* const slot = b.space + index * block_slots;
+		const uint32_t first_child = uint32_t(b.num_block);
+		exit_mask mask = 0;
+
+		block_nodes(b, b.root[index], node);
+		block_exits(b, node, child);
+
+		for (size_t i = 1; i < block_slots; ++i)
+			slot[i] = none == node[i] ? slot[i / 2] : b.key[node[i]];
+
+		for (size_t e = 0; e < block_slots; ++e)
+			if (none != child[e]) {
+				mask |= exit_mask(1 << e);
+				b.root[b.num_block++] = child[e];
+			}
+
+		memcpy(slot, &first_child, sizeof(first_child));
+		b.exits[index] = mask;
+	}
+
+public:
+	weighted_tree()
+	: num_key(0)
+	, num_block(0)
+	{
+	}
+
+	// build from an array of keys sorted in ascending order, with the number of queries of each key in a sample
+	// of the query stream; uniform_share of the total weight, 0 through 1, is spread evenly over all keys, so that
+	// keys absent from the sample still get found in bounded depth; return 0 on failure, leaving the tree intact
+	size_t build(
+		const KEY_T* const src,
+		const size_t* const count,
+		const size_t len_src,
+		const double uniform_share = 1. / 16)
+	{
+		const compile_assert< sizeof(uint32_t) <= sizeof(KEY_T) > assert_key_holds_block_index;
+
+		if (0 == len_src || uint32_t(-1) <= len_src || 0 > uniform_share || 1 < uniform_share)
+			return 0;
+
+		double total = 0;
+
+		for (size_t i = 0; i < len_src; ++i)
+			total += double(count[i]);
+
+		const double share = 0 == total ? 1 : uniform_share;
+		aligned_ptr< double, CACHELINE_SIZE > prefix(len_src + 1);
+
+		prefix[0] = 0;
+
+		for (size_t i = 0; i < len_src; ++i)
+			prefix[i + 1] = prefix[i] + share / len_src + (0 == total ? 0 : (1 - share) * count[i] / total);
+
+		aligned_ptr< uint32_t, CACHELINE_SIZE > left(len_src);
+		aligned_ptr< uint32_t, CACHELINE_SIZE > right(len_src);
+		aligned_ptr< double, CACHELINE_SIZE > cost(len_src);
+		aligned_ptr< uint32_t, CACHELINE_SIZE > block_count(len_src);
+		aligned_ptr< uint8_t, CACHELINE_SIZE > depth(len_src);
+
+		builder b;
+		b.key = src;
+		b.prefix = prefix;
+		b.uniform = share / len_src;
+		b.left = left;
+		b.right = right;
+		b.block_cost = double(block_slots - 1) / len_src;
+		b.cost = cost;
+		b.count = block_count;
+		b.depth = depth;
+		b.space = 0;
+		b.exits = 0;
+		b.root = 0;
+		b.num_block = 0;
+
+		const uint32_t root = build_node(b, 0, len_src);
+		const size_t new_num_block = b.count[root];
+
+		aligned_ptr< KEY_T, CACHELINE_SIZE > new_space(new_num_block * block_slots);
+		aligned_ptr< exit_mask, CACHELINE_SIZE > new_exits(new_num_block);
+		aligned_ptr< uint32_t, CACHELINE_SIZE > block_root(new_num_block);
+
+		b.space = new_space;
+		b.exits = new_exits;
+		b.root = block_root;
+		b.root[0] = root;
+		b.num_block = 1;
+
+		for (size_t i = 0; i < b.num_block; ++i)
+			emit_block(b, i);
+
+		space.move(new_space);
+		exits.move(new_exits);
+		num_key = len_src;
+		num_block = new_num_block;
+
+		return 1;
+	}
+
+	// number of keys in the tree
+	size_t size() const
+	{
+		return num_key;
+	}
+
+	// number of blocks of the tree
+	size_t blocks() const
+	{
+		return num_block;
+	}
+
+	// number of bytes taken by the tree
+	size_t storage_bytes() const
+	{
+		return num_block * (block_slots * sizeof(KEY_T) + sizeof(exit_mask));
+	}
+
+	// laid-out keys, as indexed by the positions returned by find
+	const KEY_T* data() const
+	{
+		return space;
+	}
+
+	// layout position of the key, or npos if absent
+	size_t find(
+		const KEY_T key) const
+	{
+		const KEY_T* const s = space;
+		const exit_mask* const x = exits;
+		size_t block = 0;
+
+		if (0 == num_block)
+			return npos;
+
+		for (;;) {
+			const KEY_T* const k = s + block * block_slots;
+			const exit_mask mask = x[block]; // load it along with the keys
+			size_t i = 1;
+
+			for (size_t level = 0; level < block_levels; ++level) {
+				if (key == k[i])
+					return block * block_slots + i;
+
+				i = i * 2 + (k[i] < key);
+			}
+
+			const size_t e = i - block_slots;
+
+			if (0 == (mask >> e & 1))
+				return npos;
+
+			uint32_t first_child;
+			memcpy(&first_child, k, sizeof(first_child));
+
+			block = first_child + __builtin_popcount(mask & (1U << e) - 1);
+		}
+	}
+
+	// number of tree levels and of blocks a search of the key touches; empty slots passed through are not levels
+	size_t levels(
+		const KEY_T key,
+		size_t& num_touched) const
+	{
+		size_t block = 0;
+		size_t level_count = 0;
+
+		num_touched = 0;
+
+		if (0 == num_block)
+			return 0;
+
+		for (;;) {
+			const KEY_T* const k = space + block * block_slots;
+			size_t i = 1;
+
+			++num_touched;
+
+			for (size_t level = 0; level < block_levels; ++level) {
+				level_count += 1 == i || k[i] != k[i / 2];
+
+				if (key == k[i])
+					return level_count;
+
+				i = i * 2 + (k[i] < key);
+			}
+
+			const size_t e = i - block_slots;
+
+			if (0 == (exits[block] >> e & 1))
+				return level_count;
+
+			uint32_t first_child;
+			memcpy(&first_child, k, sizeof(first_child));
+
+			block = first_child + __builtin_popcount(exits[block] & (1U << e) - 1);
+		}
+	}
+};
+
+} // namespace search
+
+#endif // weighted_H__